@@ -15,6 +15,7 @@
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "ScintillaTypes.h"
@@ -167,18 +168,14 @@ void SurfaceImpl::Polygon(const Point *pts, size_t npts,
   fprintf(stderr, "pts[0].x = %d, pts[0].y = %d\n", static_cast<int>(pts[0].x),
           static_cast<int>(pts[0].y));
 #endif
-  int top = reinterpret_cast<TermboxWin *>(win)->top;
-  int left = reinterpret_cast<TermboxWin *>(win)->left;
   ColourRGBA &back = fillStroke.fill.colour;
 
   if (pts[0].y < pts[npts - 1].y) // up arrow
-    tb_change_cell(left + static_cast<int>(pts[npts - 1].x - 2),
-                   top + static_cast<int>(pts[0].y), 0x25B2, 0x000000,
-                   to_rgb(back));
+    PutCell(static_cast<int>(pts[npts - 1].x - 2), static_cast<int>(pts[0].y),
+            0x25B2, 0x000000, to_rgb(back));
   else if (pts[0].y > pts[npts - 1].y) // down arrow
-    tb_change_cell(left + static_cast<int>(pts[npts - 1].x - 2),
-                   top + static_cast<int>(pts[0].y - 2), 0x25BC, 0x000000,
-                   to_rgb(back));
+    PutCell(static_cast<int>(pts[npts - 1].x - 2),
+            static_cast<int>(pts[0].y - 2), 0x25BC, 0x000000, to_rgb(back));
 }
 
 /**
@@ -229,17 +226,13 @@ void SurfaceImpl::FillRectangle(PRectangle rc, Fill fill) {
   // reinterpret_cast<TermboxWin *>(win)->right);
   int right = static_cast<int>(rc.right);
   int bottom = static_cast<int>(rc.bottom);
-  int top = 0;
-  int left = 0;
   if (win) {
     right = std::min(right, reinterpret_cast<TermboxWin *>(win)->Width());
     bottom = std::min(bottom, reinterpret_cast<TermboxWin *>(win)->Height());
-    top = reinterpret_cast<TermboxWin *>(win)->top;
-    left = reinterpret_cast<TermboxWin *>(win)->left;
   }
   for (int y = rc.top; y < rc.bottom; y++) {
     for (int x = rc.left; x < right; x++) {
-      tb_change_cell(left + x, top + y, ch, 0xffffff, to_rgb(fill.colour));
+      PutCell(x, y, ch, 0xffffff, to_rgb(fill.colour));
     }
   }
 }
@@ -335,6 +328,10 @@ void SurfaceImpl::DrawTextNoClip(PRectangle rc, const Font *font_,
                                  XYPOSITION ybase, std::string_view text,
                                  ColourRGBA fore, ColourRGBA back) {
   uint32_t attrs = dynamic_cast<const FontImpl *>(font_)->attrs;
+  // Skip text that is entirely outside the clip, like off-screen parts of long lines.
+  if ((rc.left < rc.right && rc.right <= clip.left) ||
+    rc.left >= reinterpret_cast<TermboxWin *>(win)->Width())
+    return;
   if (rc.left < clip.left) {
     // Do not overwrite margin text.
     int clip_chars = static_cast<int>(clip.left - rc.left);
@@ -352,8 +349,6 @@ void SurfaceImpl::DrawTextNoClip(PRectangle rc, const Font *font_,
   }
   // Do not write beyond right window boundary.
   int clip_chars = reinterpret_cast<TermboxWin *>(win)->Width() - rc.left;
-  int top = reinterpret_cast<TermboxWin *>(win)->top;
-  int left = reinterpret_cast<TermboxWin *>(win)->left;
   size_t bytes = 0;
   int x = rc.left;
   int y = rc.top;
@@ -383,7 +378,7 @@ void SurfaceImpl::DrawTextNoClip(PRectangle rc, const Font *font_,
     uint32_t uni;
     width = grapheme_width(str + len);
     len += utf8_char_to_unicode(&uni, str + len);
-    tb_change_cell(left + x, top + y, uni, to_rgb(fore) | attrs, to_rgb(back));
+    PutCell(x, y, uni, to_rgb(fore) | attrs, to_rgb(back));
     x += width;
     if (len >= bytes) {
       break;
@@ -423,6 +418,57 @@ void SurfaceImpl::DrawTextTransparent(PRectangle rc, const Font *font_,
                  ColourRGBA(tb_color >> 16, (tb_color & 0x00ff00) >> 8,
                             tb_color & 0x0000ff));
 }
+/** Returns whether or not the given string is entirely ASCII, which is 1 column per byte. */
+static bool is_ascii(std::string_view text) {
+  for (size_t i = 0; i < text.length(); i++)
+    if (static_cast<unsigned char>(text[i]) >= 0x80) return false;
+  return true;
+}
+
+/**
+ * Cache of the column widths of long non-ASCII text segments, keyed by a hash of their bytes.
+ * Widths do not depend on the font or window width, so re-wrapping a line after a resize or
+ * re-laying out an edited line reuses the measurements of its unchanged segments. Scintilla's
+ * own position cache only holds short segments.
+ * Each entry stores one byte per text byte: the width of the character starting there, or `0`
+ * for trailing bytes.
+ */
+static std::unordered_map<uint64_t, std::string> width_cache;
+static size_t width_cache_bytes = 0;
+constexpr size_t width_cache_min_length = 64; // shorter segments are measured directly
+constexpr size_t width_cache_max_bytes = 4 * 1024 * 1024; // cache is cleared when larger
+
+/** Returns the 64-bit FNV-1a hash of the given text, mixed with its length. */
+static uint64_t hash_text(std::string_view text) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ text.length();
+  for (size_t i = 0; i < text.length(); i++)
+    hash = (hash ^ static_cast<unsigned char>(text[i])) * 0x100000001b3ULL;
+  return hash;
+}
+
+/**
+ * Returns the widths of the characters in the given non-ASCII text, one byte per text byte,
+ * from the cache if possible.
+ */
+static const std::string &character_widths(std::string_view text) {
+  static std::string widths;
+  const bool cache = text.length() >= width_cache_min_length;
+  const uint64_t key = cache ? hash_text(text) : 0;
+  if (cache) {
+    auto it = width_cache.find(key);
+    if (it != width_cache.end() && it->second.length() == text.length()) return it->second;
+  }
+  widths.assign(text.length(), '\0');
+  for (size_t i = 0; i < text.length(); i++)
+    if (!UTF8IsTrailByte(static_cast<unsigned char>(text[i])))
+      widths[i] = static_cast<char>(grapheme_width(text.data() + i));
+  if (!cache) return widths;
+  if (width_cache_bytes + widths.length() > width_cache_max_bytes)
+    width_cache.clear(), width_cache_bytes = 0;
+  width_cache_bytes += widths.length();
+  return width_cache[key] = widths;
+}
+
 /**
  * Measures the width of characters in the given string and writes them to the
  * given position list. Curses characters always have a width of 1 if they are
@@ -430,9 +476,13 @@ void SurfaceImpl::DrawTextTransparent(PRectangle rc, const Font *font_,
  */
 void SurfaceImpl::MeasureWidths(const Font *font_, std::string_view text,
                                 XYPOSITION *positions) {
+  if (is_ascii(text)) {
+    for (size_t i = 0; i < text.length(); i++) positions[i] = i + 1;
+    return;
+  }
+  const std::string &widths = character_widths(text);
   for (size_t i = 0, j = 0; i < text.length(); i++) {
-    if (!UTF8IsTrailByte(static_cast<unsigned char>(text[i])))
-      j += grapheme_width(text.data() + i);
+    j += static_cast<unsigned char>(widths[i]);
     positions[i] = j;
   }
 }
@@ -442,10 +492,10 @@ void SurfaceImpl::MeasureWidths(const Font *font_, std::string_view text,
  * characters always have a width of 1.
  */
 XYPOSITION SurfaceImpl::WidthText(const Font *font_, std::string_view text) {
+  if (is_ascii(text)) return text.length();
   int width = 0;
-  for (size_t i = 0; i < text.length(); i++)
-    if (!UTF8IsTrailByte(static_cast<unsigned char>(text[i])))
-      width += grapheme_width(text.data() + i);
+  const std::string &widths = character_widths(text);
+  for (size_t i = 0; i < text.length(); i++) width += static_cast<unsigned char>(widths[i]);
   return width;
 }
 /** Identical to `DrawTextNoClip()` since UTF-8 is assumed. */
@@ -502,6 +552,24 @@ void SurfaceImpl::SetClip(PRectangle rc) {
 void SurfaceImpl::PopClip() {
   clip.left = 0, clip.top = 0, clip.right = 0, clip.bottom = 0;
 }
+/**
+ * Restricts subsequent drawing to the given area, relative to the window, so
+ * that repainting a damaged area leaves the cells around it untouched.
+ * An empty area removes the restriction.
+ */
+void SurfaceImpl::SetPaintClip(PRectangle rc) noexcept { paintClip = rc; }
+/**
+ * Changes the given cell, relative to the window, unless it lies outside the
+ * area set in `SetPaintClip()`.
+ */
+void SurfaceImpl::PutCell(int x, int y, uint32_t ch, uint32_t fg,
+                          uint32_t bg) {
+  if (!paintClip.Empty() && (x < paintClip.left || x >= paintClip.right ||
+                              y < paintClip.top || y >= paintClip.bottom))
+    return;
+  TermboxWin *w = reinterpret_cast<TermboxWin *>(win);
+  tb_change_cell(w->left + x, w->top + y, ch, fg, bg);
+}
 /** Flushing cache is not implemented. */
 void SurfaceImpl::FlushCachedState() {}
 /** Flushing is not implemented since surface pixmaps are not implemented. */
@@ -511,105 +579,102 @@ void SurfaceImpl::FlushDrawing() {}
 void SurfaceImpl::DrawLineMarker(const PRectangle &rcWhole,
                                  const Font *fontForCharacter, int tFold,
                                  const void *data) {
-  int top = reinterpret_cast<TermboxWin *>(win)->top;
-  int left = reinterpret_cast<TermboxWin *>(win)->left;
-
   // TODO: handle fold marker highlighting.
   const LineMarker *marker = reinterpret_cast<const LineMarker *>(data);
   // wattr_set(win, 0, term_color_pair(marker->fore, marker->back), nullptr);
 #ifdef DEBUG
-  fprintf(stderr, "drawlinemarker %d (%d, %d) -> (%f, %f)\n", marker->markType,
-          left, top, rcWhole.left, rcWhole.top);
+  fprintf(stderr, "drawlinemarker %d -> (%f, %f)\n", marker->markType,
+          rcWhole.left, rcWhole.top);
 #endif
   switch (marker->markType) {
   case MarkerSymbol::Circle:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x25CF,
+    PutCell(rcWhole.left, rcWhole.top, 0x25CF,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::SmallRect:
   case MarkerSymbol::RoundRect:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x25A0,
+    PutCell(rcWhole.left, rcWhole.top, 0x25A0,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Arrow:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x25B6,
+    PutCell(rcWhole.left, rcWhole.top, 0x25B6,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::ShortArrow:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2192,
+    PutCell(rcWhole.left, rcWhole.top, 0x2192,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Empty:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, ' ',
+    PutCell(rcWhole.left, rcWhole.top, ' ',
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::ArrowDown:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x25BC,
+    PutCell(rcWhole.left, rcWhole.top, 0x25BC,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Minus:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2500,
+    PutCell(rcWhole.left, rcWhole.top, 0x2500,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::BoxMinus:
   case MarkerSymbol::BoxMinusConnected:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x229F,
+    PutCell(rcWhole.left, rcWhole.top, 0x229F,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::CircleMinus:
   case MarkerSymbol::CircleMinusConnected:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2295,
+    PutCell(rcWhole.left, rcWhole.top, 0x2295,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Plus:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x253C,
+    PutCell(rcWhole.left, rcWhole.top, 0x253C,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::BoxPlus:
   case MarkerSymbol::BoxPlusConnected:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x229E,
+    PutCell(rcWhole.left, rcWhole.top, 0x229E,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::CirclePlus:
   case MarkerSymbol::CirclePlusConnected:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2296,
+    PutCell(rcWhole.left, rcWhole.top, 0x2296,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::VLine:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2502,
+    PutCell(rcWhole.left, rcWhole.top, 0x2502,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::LCorner:
   case MarkerSymbol::LCornerCurve:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2514,
+    PutCell(rcWhole.left, rcWhole.top, 0x2514,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::TCorner:
   case MarkerSymbol::TCornerCurve:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x251C,
+    PutCell(rcWhole.left, rcWhole.top, 0x251C,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::DotDotDot:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x22EF,
+    PutCell(rcWhole.left, rcWhole.top, 0x22EF,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Arrows:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x22D9,
+    PutCell(rcWhole.left, rcWhole.top, 0x22D9,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::FullRect:
     FillRectangle(rcWhole, marker->back);
     return;
   case MarkerSymbol::LeftRect:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x258E,
+    PutCell(rcWhole.left, rcWhole.top, 0x258E,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Bookmark:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2211,
+    PutCell(rcWhole.left, rcWhole.top, 0x2211,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   case MarkerSymbol::Bar:
-    tb_change_cell(left + rcWhole.left, top + rcWhole.top, 0x2590,
+    PutCell(rcWhole.left, rcWhole.top, 0x2590,
                    to_rgb(marker->fore), to_rgb(marker->back));
     return;
   default:
@@ -716,8 +781,16 @@ void Window::SetPositionRelative(PRectangle rc, const Window *relativeTo) {
 /** Identical to `Window::GetPosition()`. */
 PRectangle Window::GetClientPosition() const { return GetPosition(); }
 void Window::Show(bool show) {}                    // TODO:
-void Window::InvalidateAll() {}                    // notify repaint
-void Window::InvalidateRectangle(PRectangle rc) {} // notify repaint
+/** Marks the whole window for repainting on the next refresh. */
+void Window::InvalidateAll() {
+  if (wid)
+    reinterpret_cast<TermboxWin *>(wid)->Invalidate(GetPosition());
+}
+/** Marks the given area of the window for repainting on the next refresh. */
+void Window::InvalidateRectangle(PRectangle rc) {
+  if (wid)
+    reinterpret_cast<TermboxWin *>(wid)->Invalidate(rc);
+}
 /** Setting the cursor icon is not implemented. */
 void Window::SetCursor(Cursor curs) {}
 /** Identical to `Window::GetPosition()`. */
@@ -839,7 +912,6 @@ void ListBoxImpl::Select(int n) {
       }
     }
   }
-  tb_present();
   selection = n;
   if (delegate) {
     ListBoxEvent event(ListBoxEvent::EventType::selectionChange);
@@ -2,17 +2,50 @@
 #define PLAT_TERMBOX_H
 
 namespace Scintilla::Internal {
+  int to_rgb(ColourRGBA c);
+
   struct TermboxWin {
     int left;
     int top;
     int right;
     int bottom;
+    std::vector<PRectangle> damage; // areas to repaint, relative to the window
 
     explicit TermboxWin(int left_, int top_, int right_, int bottom_) noexcept :
                 left(left_), top(top_), right(right_), bottom(bottom_) {
     }
     int Width() const noexcept { return right - left + 1; }
     int Height() const noexcept { return bottom - top + 1; }
+    /**
+     * Adds the given area, relative to the window, to the areas to repaint.
+     * Overlapping areas are merged. Disjoint areas are kept apart so that small changes at
+     * opposite ends of the window do not repaint everything in between, up to a few areas,
+     * after which the new area is merged with the one it enlarges the least.
+     */
+    void Invalidate(PRectangle rc) {
+      if (rc.Empty()) return;
+      for (size_t i = 0; i < damage.size();)
+        if (rc.Intersects(damage[i])) {
+          rc = Union(rc, damage[i]);
+          damage.erase(damage.begin() + i), i = 0; // the larger area may overlap others
+        } else
+          i++;
+      if (damage.size() < 4) {
+        damage.push_back(rc);
+        return;
+      }
+      auto growth = [&rc](PRectangle area) {
+        const PRectangle merged = Union(rc, area);
+        return merged.Width() * merged.Height() - area.Width() * area.Height();
+      };
+      auto best = std::min_element(damage.begin(), damage.end(),
+        [&growth](PRectangle a, PRectangle b) { return growth(a) < growth(b); });
+      *best = Union(rc, *best);
+    }
+    static PRectangle Union(PRectangle a, PRectangle b) noexcept {
+      return PRectangle(std::min(a.left, b.left), std::min(a.top, b.top),
+        std::max(a.right, b.right), std::max(a.bottom, b.bottom));
+    }
     void Move(int newx, int newy) noexcept {
       right += newx - left;
       bottom += newy - top;
@@ -31,6 +64,7 @@ namespace Scintilla::Internal {
 
   class SurfaceImpl : public Surface {
     PRectangle clip;
+    PRectangle paintClip;
     WindowID win = nullptr;
     int width = 0;
     int height = 0;
@@ -104,6 +138,9 @@ public:
   void FlushCachedState() override;
   void FlushDrawing() override;
 
+  void SetPaintClip(PRectangle rc) noexcept;
+  void PutCell(int x, int y, uint32_t ch, uint32_t fg, uint32_t bg);
+
   void DrawLineMarker(
     const PRectangle &rcWhole, const Font *fontForCharacter, int tFold, const void *data);
   void DrawWrapMarker(PRectangle rcPlace, bool isEndMarker, ColourRGBA wrapColour);
@@ -9,15 +9,22 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <wchar.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
 #include <set>
 #include <optional>
 #include <algorithm>
@@ -122,24 +129,466 @@ void DrawTabArrow(
       s[0] = 0xFC | (code & 0x01);
   }
 
+/** Lexer state at the start of a line, from which lexing can be resumed. */
+struct LexerCheckpoint {
+  Sci::Line line; // the line lexing resumes from
+  int lineState; // line state of the previous line
+  char style; // style of the last character of the previous line
+};
+/** Comparator for finding the first checkpoint after a line with `std::upper_bound()`. */
+bool CheckpointAfter(Sci::Line line, const LexerCheckpoint &checkpoint) {
+  return line < checkpoint.line;
+}
+
+/** Returns the current time in milliseconds. */
+unsigned int Now() {
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+/** Milliseconds between frames of kinetic scrolling and followed appends. */
+constexpr unsigned int frameInterval = 16;
+
+/** Text attributes selected by ANSI SGR escape sequences. */
+struct AnsiAttributes {
+  int fore = -1, back = -1; // Scintilla colours, or -1 for the default style's colours
+  bool bold = false, italic = false, underline = false, reverse = false;
+  /** Returns a key that uniquely identifies these attributes. */
+  uint64_t Key() const {
+    return static_cast<uint64_t>(fore + 1) | static_cast<uint64_t>(back + 1) << 25 |
+      static_cast<uint64_t>(bold | italic << 1 | underline << 2 | reverse << 3) << 50;
+  }
+};
+
+/** Returns the Scintilla colour of the given xterm 256-colour palette index. */
+int AnsiColour(int index) {
+  static constexpr int basic[16] = {0x000000, 0x0000cd, 0x00cd00, 0x00cdcd, 0xee0000, 0xcd00cd,
+    0xcdcd00, 0xe5e5e5, 0x7f7f7f, 0x0000ff, 0x00ff00, 0x00ffff, 0xff5c5c, 0xff00ff, 0xffff00,
+    0xffffff}; // 0xBBGGRR
+  if (index < 16) return basic[std::max(index, 0)];
+  if (index >= 232) return (8 + (index - 232) * 10) * 0x010101; // greyscale ramp
+  index -= 16;
+  auto level = [](int i) { return i == 0 ? 0 : 55 + i * 40; };
+  return level(index / 36) | level(index / 6 % 6) << 8 | level(index % 6) << 16;
+}
+
+/**
+ * Applies the parameters of an SGR escape sequence (`ESC [ params m`) to the given attributes.
+ * Supports the basic, bright, 256, and 24-bit colours, and bold, italic, underline, and reverse.
+ * Extended colours may be given in the semicolon form (`38;2;r;g;b`) or in the colon form,
+ * with or without a colour space (`38:2::r:g:b` or `38:2:r:g:b`).
+ */
+void ApplySGR(AnsiAttributes &attrs, std::string_view params) {
+  // Parameters are separated by ';', and sub-parameters by ':'. Empty ones are -1.
+  std::vector<std::vector<int>> codes(1, std::vector<int>(1, -1));
+  for (char ch : params)
+    if (ch == ';')
+      codes.emplace_back(1, -1);
+    else if (ch == ':')
+      codes.back().push_back(-1);
+    else if (ch >= '0' && ch <= '9') {
+      int &value = codes.back().back();
+      value = std::min(std::max(value, 0) * 10 + (ch - '0'), 0xffff);
+    }
+  auto rgb = [](int r, int g, int b) {
+    return std::clamp(r, 0, 255) | std::clamp(g, 0, 255) << 8 | std::clamp(b, 0, 255) << 16;
+  };
+  for (size_t i = 0; i < codes.size(); i++) {
+    const std::vector<int> &sub = codes[i];
+    const int code = std::max(sub[0], 0); // `ESC [ m` is a reset
+    if (code == 38 || code == 48) {
+      int colour = -1;
+      if (sub.size() > 1) {
+        // Colon form: `5:index`, `2:r:g:b`, or `2:colourspace:r:g:b`.
+        if (sub[1] == 5 && sub.size() > 2)
+          colour = AnsiColour(std::clamp(sub[2], 0, 255));
+        else if (sub[1] == 2 && sub.size() > 5)
+          colour = rgb(sub[3], sub[4], sub[5]);
+        else if (sub[1] == 2 && sub.size() == 5)
+          colour = rgb(sub[2], sub[3], sub[4]);
+      } else if (i + 2 < codes.size() && codes[i + 1][0] == 5) {
+        // Semicolon form: `5;index` or `2;r;g;b`.
+        colour = AnsiColour(std::clamp(codes[i + 2][0], 0, 255)), i += 2;
+      } else if (i + 4 < codes.size() && codes[i + 1][0] == 2) {
+        colour = rgb(codes[i + 2][0], codes[i + 3][0], codes[i + 4][0]), i += 4;
+      }
+      if (colour >= 0) (code == 38 ? attrs.fore : attrs.back) = colour;
+    } else if (code == 4 && sub.size() > 1)
+      attrs.underline = sub[1] != 0; // `4:0` is no underline, `4:3` a curly one, etc.
+    else if (code == 0)
+      attrs = AnsiAttributes{};
+    else if (code == 1)
+      attrs.bold = true;
+    else if (code == 3)
+      attrs.italic = true;
+    else if (code == 4)
+      attrs.underline = true;
+    else if (code == 7)
+      attrs.reverse = true;
+    else if (code == 22)
+      attrs.bold = false;
+    else if (code == 23)
+      attrs.italic = false;
+    else if (code == 24)
+      attrs.underline = false;
+    else if (code == 27)
+      attrs.reverse = false;
+    else if (code >= 30 && code <= 37)
+      attrs.fore = AnsiColour(code - 30);
+    else if (code == 39)
+      attrs.fore = -1;
+    else if (code >= 40 && code <= 47)
+      attrs.back = AnsiColour(code - 40);
+    else if (code == 49)
+      attrs.back = -1;
+    else if (code >= 90 && code <= 97)
+      attrs.fore = AnsiColour(code - 90 + 8);
+    else if (code >= 100 && code <= 107)
+      attrs.back = AnsiColour(code - 100 + 8);
+  }
+}
+
+/**
+ * Returns the index just past the escape sequence that starts at *start* in the given text, or
+ * `std::string_view::npos` if the sequence is incomplete.
+ * Handles CSI sequences (`ESC [ ... final`), OSC sequences terminated by BEL or `ESC \`, and
+ * two-byte escapes.
+ */
+size_t EscapeSequenceEnd(std::string_view text, size_t start) {
+  if (start + 1 >= text.length()) return std::string_view::npos;
+  const char kind = text[start + 1];
+  if (kind == '[') {
+    for (size_t i = start + 2; i < text.length(); i++)
+      if (text[i] >= 0x40 && text[i] <= 0x7e) return i + 1;
+  } else if (kind == ']') {
+    for (size_t i = start + 2; i < text.length(); i++)
+      if (text[i] == '\a')
+        return i + 1;
+      else if (text[i] == '\x1b' && i + 1 < text.length() && text[i + 1] == '\\')
+        return i + 2;
+  } else
+    return start + 2;
+  return std::string_view::npos;
+}
+
+/** Returns the number of milliseconds until the frame after the given one, or `0` if it is due. */
+int UntilNextFrame(unsigned int lastFrame, unsigned int now) {
+  const unsigned int elapsed = now - lastFrame;
+  return elapsed < frameInterval ? frameInterval - elapsed : 0;
+}
+
+/** Returns the 64-bit FNV-1a hash of the given bytes, continuing from the given hash. */
+uint64_t Hash(std::string_view bytes, uint64_t hash = 0xcbf29ce484222325ULL) {
+  for (size_t i = 0; i < bytes.length(); i++)
+    hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 0x100000001b3ULL;
+  return hash;
+}
+
+/** A read-only memory mapping of a whole file. */
+class MappedFile {
+  void *data = MAP_FAILED;
+  size_t size = 0;
+
+public:
+  explicit MappedFile(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size = st.st_size;
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() {
+    if (data != MAP_FAILED) munmap(data, size);
+  }
+  /** Returns the file's contents, or an empty view if the file could not be mapped. */
+  std::string_view View() const {
+    return data != MAP_FAILED ? std::string_view(static_cast<const char *>(data), size) :
+                                std::string_view();
+  }
+};
+
+/**
+ * Reads a value of the given type from the start of the given bytes, advancing past it.
+ * @return whether or not there were enough bytes
+ */
+template <typename T> bool ReadValue(std::string_view &bytes, T &value) {
+  if (bytes.length() < sizeof(T)) return false;
+  memcpy(&value, bytes.data(), sizeof(T));
+  bytes.remove_prefix(sizeof(T));
+  return true;
+}
+
+/**
+ * Reads the given number of bytes from the start of the given bytes, advancing past them and
+ * any padding up to a multiple of 8 bytes.
+ * @return whether or not there were enough bytes
+ */
+bool ReadBytes(std::string_view &bytes, size_t length, std::string_view &value) {
+  if (length > bytes.length()) return false; // also keeps the padding from overflowing
+  const size_t padded = (length + 7) & ~static_cast<size_t>(7);
+  if (bytes.length() < padded) return false;
+  value = bytes.substr(0, length);
+  bytes.remove_prefix(padded);
+  return true;
+}
+
+/** Writes the given bytes to the given file, followed by padding up to a multiple of 8 bytes. */
+bool WriteBytes(FILE *f, const void *bytes, size_t length) {
+  static constexpr char padding[8] = {};
+  const size_t pad = -length & 7;
+  return fwrite(bytes, 1, length, f) == length && fwrite(padding, 1, pad, f) == pad;
+}
+
+/** Header of a style cache file, followed by styles, fold levels, and line states. */
+struct StyleCacheHeader {
+  uint64_t magic; // styleCacheMagic
+  uint64_t contentHash; // hash of the document's text
+  uint64_t lexerHash; // hash of the lexer's name and the cache version
+  uint64_t length; // length of the document and number of styles
+  uint64_t lines; // number of lines, fold levels, and line states
+};
+constexpr uint64_t styleCacheMagic = 0x3145484341435453ULL; // "STCACHE1"
+
+/**
+ * Header of a session file, followed by the text, styles, fold levels, line states, marker
+ * masks, fold states, and selections.
+ */
+struct SessionHeader {
+  uint64_t magic; // sessionMagic
+  uint64_t length; // length of the text and number of styles
+  uint64_t lines; // number of lines and of each kind of per-line data
+  uint64_t selections; // number of selections
+  uint64_t mainSelection; // index of the main selection
+  int64_t topLine; // first visible display line
+  int64_t xOffset; // horizontal scroll position
+};
+constexpr uint64_t sessionMagic = 0x3130535345534353ULL; // "SCSESS01"
+
+/**
+ * Returns the number of lines Scintilla would split the given text into: CR, LF, and CR+LF
+ * end lines, as do NEL, LS, and PS if Unicode line ends are enabled.
+ */
+uint64_t CountLines(std::string_view text, bool unicodeLineEnds) {
+  uint64_t lines = 1;
+  for (size_t i = 0; i < text.length(); i++)
+    if (text[i] == '\n' || (text[i] == '\r' && (i + 1 == text.length() || text[i + 1] != '\n')))
+      lines++;
+    else if (unicodeLineEnds && i + 1 < text.length() &&
+      ((text[i] == '\xc2' && text[i + 1] == '\x85') ||
+        (i + 2 < text.length() && text[i] == '\xe2' && text[i + 1] == '\x80' &&
+          (text[i + 2] == '\xa8' || text[i + 2] == '\xa9'))))
+      lines++;
+  return lines;
+}
+
+/** Per-line fold state in a session file. */
+enum SessionFoldState : unsigned char { foldExpanded = 1, foldVisible = 2 };
+
+/** Appends an LZ4-style length continuation, where 255 means more bytes follow. */
+void AppendLength(std::string &out, size_t length) {
+  for (; length >= 255; length -= 255) out += '\xff';
+  out += static_cast<char>(length);
+}
+
+/**
+ * Compresses the given bytes with an LZ77 scheme in the style of LZ4.
+ * Each sequence is a token of literal and match length nibbles, the literals, and a 2-byte match
+ * offset. Lengths of 15 or more continue in following bytes. The last sequence has no match.
+ */
+std::string Compress(std::string_view in) {
+  std::string out;
+  std::vector<size_t> table(1 << 14, SIZE_MAX); // last position of each hashed 4-byte word
+  size_t anchor = 0; // start of pending literals
+  auto emit = [&](size_t literalEnd, size_t offset, size_t matchLength) {
+    const size_t literals = literalEnd - anchor, extra = matchLength > 4 ? matchLength - 4 : 0;
+    out += static_cast<char>(std::min<size_t>(literals, 15) << 4 | std::min<size_t>(extra, 15));
+    if (literals >= 15) AppendLength(out, literals - 15);
+    out.append(in.data() + anchor, literals);
+    if (matchLength == 0) return;
+    out += static_cast<char>(offset & 0xff), out += static_cast<char>(offset >> 8);
+    if (extra >= 15) AppendLength(out, extra - 15);
+  };
+  for (size_t i = 0; i + 4 <= in.length();) {
+    uint32_t word, candidateWord;
+    memcpy(&word, in.data() + i, 4);
+    const size_t hash = static_cast<uint32_t>(word * 2654435761U) >> 18;
+    const size_t candidate = table[hash];
+    table[hash] = i;
+    if (candidate == SIZE_MAX || i - candidate > 0xffff) {
+      i++;
+      continue;
+    }
+    memcpy(&candidateWord, in.data() + candidate, 4);
+    if (candidateWord != word) {
+      i++;
+      continue;
+    }
+    size_t length = 4;
+    while (i + length < in.length() && in[candidate + length] == in[i + length]) length++;
+    emit(i, i - candidate, length);
+    i += length, anchor = i;
+  }
+  emit(in.length(), 0, 0);
+  return out;
+}
+
+/** Decompresses bytes compressed by `Compress()` into the given number of bytes. */
+std::string Decompress(std::string_view in, size_t length) {
+  std::string out;
+  out.reserve(length);
+  size_t i = 0;
+  auto readLength = [&](size_t value) {
+    if (value < 15) return value;
+    unsigned char byte;
+    do
+      value += byte = static_cast<unsigned char>(in[i++]);
+    while (byte == 255 && i < in.length());
+    return value;
+  };
+  while (i < in.length()) {
+    const unsigned char token = in[i++];
+    const size_t literals = readLength(token >> 4);
+    out.append(in.data() + i, literals);
+    i += literals;
+    if (i + 2 > in.length()) break; // last sequence
+    const size_t offset = static_cast<unsigned char>(in[i]) |
+      static_cast<unsigned char>(in[i + 1]) << 8;
+    i += 2;
+    const size_t match = readLength(token & 15) + 4, from = out.length() - offset;
+    for (size_t j = 0; j < match; j++) out += out[from + j]; // matches may overlap
+  }
+  return out;
+}
+
+int sentCursorShape = 0; // DECSCUSR cursor shape last sent to the terminal, `0` for its default
+const void *cursorShapeSender = nullptr; // instance that last set the cursor shape
+
+/**
+ * Sends the given DECSCUSR cursor shape to the terminal.
+ * termbox has no escape sequence for this and does not expose its descriptor, so the sequence
+ * is written to the controlling terminal termbox opens by default instead of standard output,
+ * which may be redirected.
+ */
+void SendCursorShape(int shape) {
+  static const int tty = open("/dev/tty", O_WRONLY | O_CLOEXEC);
+  sentCursorShape = shape;
+  if (tty < 0) return;
+  char sequence[16];
+  const int length = snprintf(sequence, sizeof(sequence), "\x1b[%d q", shape);
+  if (write(tty, sequence, length) < length) return; // nothing to do about a partial write
+}
+
+/** A large edit whose undo and redo text is stored compressed instead of in undo history. */
+struct CompressedEdit {
+  Sci::Position position; // start of the edit
+  size_t removedLength, insertedLength; // lengths of the removed and inserted text
+  size_t removedSize, insertedSize; // compressed sizes of the removed and inserted text
+  std::string data; // compressed removed and inserted text, or empty if spilled
+  long spillOffset = -1; // offset of the compressed text in the spill file, if spilled
+  bool undone = false; // whether the edit is undone and only reachable by redo
+};
+
+/**
+ * The compressed edits of a document.
+ * Undo history belongs to the document, so its compressed edits are shared by all views of it
+ * and outlive a view that switches to another document.
+ */
+struct CompressedUndo {
+  std::list<CompressedEdit> edits; // compressed edits, oldest first
+  size_t bytes = 0; // bytes of compressed text in memory
+  FILE *spill = nullptr; // temporary file with spilled compressed text
+  std::optional<std::pair<CompressedEdit *, bool>> pending; // compressed edit to undo or redo
+  CompressedUndo() = default;
+  CompressedUndo(const CompressedUndo &) = delete;
+  CompressedUndo &operator=(const CompressedUndo &) = delete;
+  ~CompressedUndo() {
+    if (spill) fclose(spill);
+  }
+};
+std::map<const Document *, CompressedUndo> compressedUndos; // compressed edits by document
+
   } // namespace
 
 /** Implementation of Scintilla for termbox. */
 class ScintillaTermbox : public ScintillaBase {
-  std::unique_ptr<Surface> sur; // window surface to draw on
+  std::unique_ptr<Surface> sur; // window surface to draw on, or null until initialized
+  bool lazyInitPending = false; // whether the surface and styles still need initializing
+  int suspendedPositionCache = -1; // position cache size while suspended, or -1 if not
+  size_t compressedUndoThreshold = 0; // minimum length of compressed edits, or 0 for none
+  size_t compressedUndoMemory = 0; // compressed text kept in memory before spilling to disk
+  int undoGroupDepth = 0; // nesting of BeginUndoAction()
   int width = 0, height = 0; // window dimensions
   void (*callback)(void *, int, SCNotification *, void *); // SCNotification cb
   void *userdata; // userdata for SCNotification callbacks
   int scrollBarVPos, scrollBarHPos; // positions of the scroll bars
   int scrollBarHeight = 1, scrollBarWidth = 1; // scroll bar height and width
+  int scrollBarHeight8 = 8; // vertical scroll bar height in eighths of a cell
+  std::vector<tb_cell> drawnVBar; // vertical scroll bar on screen, or empty if unknown
+  int drawnHPos = -1, drawnHWidth = 0; // horizontal scroll bar on screen, or -1 if unknown
+  int lastScrollWidth = 0; // scroll width when the scroll bars were last sized
+  unsigned int lastHScrollTime = 0; // time of the last horizontal scroll
+  int hScrollStep = 0; // columns scrolled by the last horizontal scroll
+  Sci::Line pendingScroll = 0; // lines scrolled by the wheel but not yet applied
+  unsigned int lastScrollFrame = 0; // time pending scroll was last applied
+  bool scrollEasing = true; // whether pending scroll is eased over several frames
+  Sci::Position longLineLength = 0; // length of a long line, or 0 to disable long line mode
+  int normalLayoutCache = -1; // layout cache level outside long line mode, or -1 if not in it
+  /** Settings changed by pager mode, saved so they can be restored when it is disabled. */
+  struct PagerSettings {
+    bool readOnly, undoCollection;
+    int changeHistory, idleStyling, layoutCache;
+  };
+  std::optional<PagerSettings> pagerSettings; // settings before pager mode, if enabled
+  std::string followText; // text appended by scintilla_append_follow() but not yet inserted
+  unsigned int lastFollowFlush = 0; // time followed text was last inserted
+  Sci::Line maxLines = 0; // number of lines the document is trimmed to, or 0 for no limit
+  bool trimPending = false; // whether the document has grown enough to be trimmed
+  bool trimRecordsUndo = false; // whether trims are recorded in undo history instead of cleared
+  bool ansiStyling = false; // whether followed text is styled from ANSI escape sequences
+  std::string followStyles; // styles of followText when ANSI styling is enabled
+  std::string ansiPending; // incomplete escape sequence at the end of the last append
+  AnsiAttributes ansiAttributes; // attributes selected by the last SGR escape sequence
+  int ansiStyle = 0; // style for ansiAttributes
+  static constexpr int ansiFirstStyle = STYLE_LASTPREDEFINED + 1; // first style for ANSI
+  std::map<uint64_t, int> ansiStyles; // styles allocated for ANSI attributes by key
+  std::vector<std::pair<uint64_t, unsigned int>> ansiStyleUse; // key and last use per style
+  unsigned int ansiStyleClock = 0; // incremented each time a style is looked up
+  bool popupVisible = false; // whether an autocompletion list or calltip was last drawn
+  bool contentChanged = false; // whether more than the caret changed during a key press
   SelectionText clipboard; // current clipboard text
   bool capturedMouse; // whether or not the mouse is currently captured
+  bool mouseInside = false; // whether or not the last mouse motion was inside the window
   unsigned int autoCompleteLastClickTime; // last click time in the AC box
   bool draggingVScrollBar, draggingHScrollBar; // a scrollbar is being dragged
   int dragOffset; // the distance to the position of the scrollbar being dragged
+  bool ticking = false; // whether or not the application calls scintilla_tick()
+  struct FineTicker {
+    unsigned int deadline; // time from Now() at which the ticker next fires
+    int interval; // milliseconds between firings
+  };
+  std::map<TickReason, FineTicker> fineTickers; // running tickers, fired from Tick()
+  struct CaretCell {
+    int x, y; // screen position
+    tb_cell cell; // text under the caret
+    uint32_t fg, bg; // colours the caret was drawn in
+  };
+  std::vector<CaretCell> caretCells; // carets drawn over the text, in drawing order
+  bool cursorShapes = true; // whether the terminal cursor takes the main caret's shape
+  bool partialRefresh = false; // whether refreshes only repaint what changed
+  int checkpointInterval = 0; // lines between lexer checkpoints, or 0 for none
+  std::vector<LexerCheckpoint> checkpoints; // lexer checkpoints sorted by line
+  Sci::Line checkpointsExactTo = 0; // checkpoints up to this line match the document
+  Sci::Position speculativeStart = 0, speculativeEnd = 0; // range last lexed from a checkpoint
+  Sci::Position speculativeEndStyled = 0; // end of styling when that range was lexed
 
 public:
-  ScintillaTermbox(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_);
+  ScintillaTermbox(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_,
+    bool lazy = false);
     virtual ~ScintillaTermbox() override;
 
     private:
@@ -157,11 +606,15 @@ public:
   
   void NotifyChange() override;
   void NotifyParent(NotificationData scn) override;
+  void NotifyModified(Document *document, DocModification mh, void *userData) override;
 
   int KeyDefault(Keys key, KeyMod modifiers) override;
+  bool InsertAtCarets(std::string_view text);
 
   void CopyToClipboard(const SelectionText &selectedText) override;
 
+  bool SetIdle(bool on) override;
+
   bool FineTickerRunning(TickReason reason) override;
   void FineTickerStart(TickReason reason, int millis, int tolerance) override;
   void FineTickerCancel(TickReason reason) override;
@@ -178,6 +631,20 @@ public:
 
   void AddToPopUp(const char *label, int cmd = 0, bool enabled = true) override;
 
+  void UpdateCheckpoints();
+  void StyleFromCheckpoint();
+
+  void ScrollColumns(int columns);
+  void AccelerateHorizontalScroll(int direction, unsigned int time);
+  bool ScrollFrame(unsigned int time);
+  Sci::Line UnwrappedLinesEstimate();
+  void UpdateLongLineMode();
+  void FlushFollow();
+  void TrimLines();
+  void AppendAnsi(std::string_view text);
+  int AnsiStyle(const AnsiAttributes &attrs);
+  void ResetAnsiStyles();
+
   public:
   sptr_t WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) override;
 
@@ -188,13 +655,48 @@ public:
   TermboxWin *GetWINDOW();
 
   void UpdateCursor();
+  void HideCarets();
+  void ShowCarets();
+  int CursorShape();
+  void UpdateCursorShape();
+  void SetCursorShapes(bool on);
+  void SetPartialRefresh(bool on);
+
+  void LazyInitialise();
+
+  void Suspend();
+
+  void MemoryUsage(sci_mem_stats *stats);
+
+  std::optional<sptr_t> CompressedEditMessage(Message iMessage, uptr_t wParam, sptr_t lParam);
+  std::string CompressedEditText(const CompressedEdit &edit, bool removed);
+  void SpillCompressedEdits();
+  CompressedUndo *FindCompressedUndo();
+  CompressedEdit *FindCompressedEdit(Sci::Position token);
+  void ApplyPendingUndo();
+  void PruneCompressedEdits();
+  void ClearCompressedEdits();
+  void DeleteUndoHistory();
+
+  void SetCompressedUndo(size_t threshold, size_t memory);
+
+  int ReplaceAll(const char *find, const char *replace, FindOption flags, Sci::Position start,
+    Sci::Position end);
+
+  void Resume();
 
   void Refresh();
 
+  void Invalidate();
+
   void KeyPress(int key, bool shift, bool ctrl, bool alt);
+  void InvalidateCaretMove(Point before, Point after);
 
   bool MousePress(int button, int y, int x, bool shift, bool ctrl, bool alt);
+  PRectangle RectangularSelectionCells();
+  void InvalidateSelectionChange(PRectangle before, PRectangle after);
   bool MouseMove(int y, int x, bool shift, bool ctrl, bool alt);
+  bool MouseHover(int y, int x, bool inside);
   void MouseRelease(int y, int x, int ctrl);
 
   char *GetClipboard(int *len);
@@ -202,6 +704,36 @@ public:
   void Resize(int width, int height);
 
   void Move(int new_x, int new_y);
+
+  void SetBounds(int left, int top, int right, int bottom);
+
+  int Timeout();
+
+  bool Tick();
+
+  void SetCheckpointInterval(int interval);
+
+  void SetScrollEasing(bool easing);
+
+  void SetLongLineLength(Sci::Position length);
+
+  void SetPagerMode(bool on);
+
+  void AppendFollow(const char *text, size_t len);
+
+  void SetMaxLines(Sci::Line lines, bool recordUndo);
+
+  void SetAnsiStyling(bool on);
+
+  uint64_t LexerHash(int version);
+
+  bool SaveStyleCache(const char *path, int version);
+
+  bool LoadStyleCache(const char *path, int version);
+
+  bool SaveSession(const char *path);
+
+  bool LoadSession(const char *path);
 };
 
   /**
@@ -209,9 +741,12 @@ public:
    * However, the `WINDOW` itself will not be created until it is absolutely necessary. When the
    * `WINDOW` is created, it will initially be full-screen.
    * @param callback_ Callback function for Scintilla notifications.
+   * @param lazy Whether or not to defer allocating the surface and refreshing styles until the
+   *   first refresh.
    */
-  ScintillaTermbox::ScintillaTermbox(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_)
-      : sur(Surface::Allocate(Technology::Default)), callback(callback_), userdata(userdata_) {
+  ScintillaTermbox::ScintillaTermbox(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_,
+    bool lazy)
+      : lazyInitPending(true), callback(callback_), userdata(userdata_) {
     // Defaults for curses.
     marginView.wrapMarkerPaddingRight = 0; // no padding for margin wrap markers
     marginView.customDrawWrapMarker = DrawWrapVisualMarker; // draw text markers
@@ -224,7 +759,8 @@ public:
     mouseSelectionRectangularSwitch = true; // easier rectangular selection
     doubleClickCloseThreshold = Point(0, 0); // double-clicks only in same cell
     horizontalScrollBarVisible = false; // no horizontal scroll bar
-    scrollWidth = 5 * width; // reasonable default for any horizontal scroll bar
+    scrollWidth = 1; // grown from the widest line laid out so far
+    trackLineWidth = true; // for an accurate horizontal scroll bar
     vs.SetElementRGB(Element::SelectionText, 0x000000); // black on white selection
     vs.SetElementRGB(Element::SelectionAdditionalText, 0x000000);
     vs.SetElementRGB(Element::SelectionAdditionalBack, 0xFFFFFF);
@@ -266,11 +802,352 @@ public:
     width = tb_width();
 //    wMain = tb_cell_buffer();
     wMain = new TermboxWin(0, 0, width - 1, height - 1);
+    if (!lazy) LazyInitialise();
+  }
+  /**
+   * Allocates the window surface and refreshes styles, unless already done.
+   * Instances created with `scintilla_new_lazy()` defer this until their first refresh, so
+   * hidden instances stay cheap. Until then, styles are refreshed on demand by Scintilla.
+   */
+  void ScintillaTermbox::LazyInitialise() {
+    if (!lazyInitPending) return;
+    lazyInitPending = false;
+    sur = Surface::Allocate(Technology::Default);
     if (sur) sur->Init(wMain.GetID());
     InvalidateStyleRedraw(); // needed to fully initialize Scintilla
   }
+  /**
+   * Frees the caches of an instance that is not displayed, keeping the document and the state
+   * needed to display it again.
+   * Drops the position and line layout caches, pixmaps, the surface, and any popups. The
+   * instance resumes on its next refresh.
+   */
+  void ScintillaTermbox::Suspend() {
+    if (suspendedPositionCache >= 0) return;
+    FlushFollow();
+    CancelModes(); // autocompletion and calltip popups
+    suspendedPositionCache = WndProc(Message::GetPositionCache, 0, 0);
+    WndProc(Message::SetPositionCache, 0, 0);
+    view.llc.Deallocate();
+    DropGraphics();
+    sur.reset(), lazyInitPending = true;
+    std::string().swap(followText), std::string().swap(followStyles);
+    std::vector<tb_cell>().swap(drawnVBar);
+    std::vector<CaretCell>().swap(caretCells); // the window is redrawn in full on resume
+  }
+  /**
+   * Estimates the memory used by this instance.
+   * Counts are derived from the document and caches rather than from the allocator, so
+   * container overheads are approximate.
+   */
+  void ScintillaTermbox::MemoryUsage(sci_mem_stats *stats) {
+    *stats = sci_mem_stats{};
+    const Sci::Position length = pdoc->Length();
+    const Sci::Line lines = pdoc->LinesTotal();
+    stats->text = stats->styles = length;
+    // Bypass WndProc(), which would flush followed text and so modify the document.
+    auto send = [this](Message msg, uptr_t wParam, sptr_t lParam) {
+      return ScintillaBase::WndProc(msg, wParam, lParam);
+    };
+    const int actions = send(Message::GetUndoActions, 0, 0);
+    for (int action = 0; action < actions; action++)
+      stats->undo += send(Message::GetUndoActionText, action, 0) + sizeof(Sci::Position) * 2;
+    if (const CompressedUndo *compressed = FindCompressedUndo())
+      stats->undo += compressed->bytes + compressed->edits.size() * sizeof(CompressedEdit);
+    // Line starts plus fold levels and line states, which are allocated per line.
+    stats->line_index = lines * (sizeof(Sci::Position) + sizeof(int) * 2);
+    // Each marked line holds a list of marker handles and each indicator run a start and value.
+    for (Sci::Line line = send(Message::MarkerNext, 0, ~0); line >= 0;
+         line = send(Message::MarkerNext, line + 1, ~0))
+      stats->markers += sizeof(void *) * 4;
+    for (int indicator = 0; indicator <= INDICATOR_MAX; indicator++)
+      for (Sci::Position pos = 0; pos < length;) {
+        const Sci::Position end = send(Message::IndicatorEnd, indicator, pos);
+        if (end <= pos) break;
+        stats->markers += sizeof(Sci::Position) + sizeof(int);
+        pos = end;
+      }
+    // Cached layouts hold characters, styles, and positions for each byte of their lines.
+    if (suspendedPositionCache < 0) {
+      const Sci::Line lineTop = pcs->DocFromDisplay(topLine);
+      const Sci::Line lineBottom = pcs->DocFromDisplay(topLine + LinesOnScreen());
+      for (Sci::Line line = lineTop; line <= lineBottom && line < lines; line++)
+        stats->caches += (pdoc->LineEnd(line) - pdoc->LineStart(line)) * (2 + sizeof(XYPOSITION));
+      stats->caches += send(Message::GetPositionCache, 0, 0) * 32 * sizeof(XYPOSITION);
+    }
+    stats->platform = clipboard.Length() + followText.capacity() + followStyles.capacity() +
+      ansiPending.capacity() + checkpoints.capacity() * sizeof(LexerCheckpoint) +
+      drawnVBar.capacity() * sizeof(tb_cell) + sizeof(TermboxWin) + sizeof(*this);
+    if (ac.Active()) stats->platform += ac.lb->Length() * 32;
+  }
+  /**
+   * Performs the given editing message as a compressed edit if compressed undo is enabled and
+   * the edit is large enough.
+   * The edit is performed with undo collection paused and a container undo action is added in
+   * its place. The action's token is the address of the stored edit, which cannot be confused
+   * with the small integers or pointers hosts pass to `SCI_ADDUNDOACTION`. Edits inside undo
+   * groups are left to Scintilla, since a group is undone as one step and a compressed edit can
+   * only be applied after that step. So are edits that fill virtual space, whose inserted length
+   * is not known up front.
+   * @return the message's result, or no value if the message should be passed to Scintilla
+   */
+  std::optional<sptr_t> ScintillaTermbox::CompressedEditMessage(
+    Message iMessage, uptr_t wParam, sptr_t lParam) {
+    if (compressedUndoThreshold == 0 || undoGroupDepth > 0 || !pdoc->IsCollectingUndo() ||
+      pdoc->IsReadOnly())
+      return std::nullopt;
+    const char *text = reinterpret_cast<const char *>(lParam);
+    Sci::Position start = 0, end = pdoc->Length();
+    size_t length = 0;
+    if (iMessage == Message::ReplaceTarget) {
+      if (targetRange.start.VirtualSpace() || targetRange.end.VirtualSpace())
+        return std::nullopt;
+      start = targetRange.start.Position(), end = targetRange.end.Position();
+      length = static_cast<sptr_t>(wParam) < 0 ? strlen(text) : wParam;
+    } else if (iMessage == Message::ReplaceSel) {
+      if (sel.Count() > 1 || sel.IsRectangular() || sel.RangeMain().caret.VirtualSpace() ||
+        sel.RangeMain().anchor.VirtualSpace())
+        return std::nullopt;
+      start = sel.RangeMain().Start().Position(), end = sel.RangeMain().End().Position();
+      length = strlen(text);
+    } else if (iMessage == Message::DeleteRange) {
+      start = wParam, end = start + lParam;
+    } else if (iMessage == Message::SetText) {
+      if (!text) return std::nullopt;
+      length = strlen(text);
+    }
+    if (start < 0 || end > pdoc->Length() || start > end ||
+      static_cast<size_t>(end - start) + length < compressedUndoThreshold)
+      return std::nullopt;
+    std::string removed(end - start, '\0');
+    pdoc->GetCharRange(removed.data(), start, end - start);
+    CompressedEdit edit{start, removed.length(), length};
+    edit.data = Compress(removed);
+    edit.removedSize = edit.data.length();
+    edit.data += Compress(std::string_view(text ? text : "", length));
+    edit.insertedSize = edit.data.length() - edit.removedSize;
+    pdoc->SetUndoCollection(false);
+    const sptr_t result = ScintillaBase::WndProc(iMessage, wParam, lParam);
+    pdoc->SetUndoCollection(true);
+    CompressedUndo &compressed = compressedUndos[pdoc];
+    compressed.bytes += edit.data.length();
+    compressed.edits.push_back(std::move(edit));
+    pdoc->AddUndoAction(reinterpret_cast<Sci::Position>(&compressed.edits.back()), false);
+    PruneCompressedEdits(); // adding an action discards redo
+    SpillCompressedEdits();
+    return result;
+  }
+  /** Returns the removed or inserted text of the given compressed edit. */
+  std::string ScintillaTermbox::CompressedEditText(const CompressedEdit &edit, bool removed) {
+    const size_t offset = removed ? 0 : edit.removedSize;
+    const size_t size = removed ? edit.removedSize : edit.insertedSize;
+    const size_t length = removed ? edit.removedLength : edit.insertedLength;
+    if (edit.spillOffset < 0) return Decompress(std::string_view(edit.data).substr(offset, size), length);
+    if (size == 0) return std::string();
+    // Map the pages of the spill file that hold the text.
+    FILE *spill = FindCompressedUndo()->spill;
+    fflush(spill);
+    const size_t start = edit.spillOffset + offset;
+    const size_t page = sysconf(_SC_PAGESIZE), mapStart = start / page * page;
+    void *map = mmap(nullptr, start + size - mapStart, PROT_READ, MAP_PRIVATE,
+      fileno(spill), mapStart);
+    if (map == MAP_FAILED) return std::string();
+    std::string text = Decompress(
+      std::string_view(static_cast<const char *>(map) + (start - mapStart), size), length);
+    munmap(map, start + size - mapStart);
+    return text;
+  }
+  /**
+   * Moves the compressed text of the oldest edits to a temporary file until the compressed text
+   * in memory is within the limit.
+   */
+  void ScintillaTermbox::SpillCompressedEdits() {
+    CompressedUndo *compressed = FindCompressedUndo();
+    if (!compressed) return;
+    for (CompressedEdit &edit : compressed->edits) {
+      if (compressed->bytes <= compressedUndoMemory) return;
+      if (edit.spillOffset >= 0) continue;
+      if (!compressed->spill && !(compressed->spill = tmpfile())) return;
+      fseek(compressed->spill, 0, SEEK_END);
+      const long offset = ftell(compressed->spill);
+      if (fwrite(edit.data.data(), 1, edit.data.length(), compressed->spill) !=
+        edit.data.length())
+        return;
+      edit.spillOffset = offset;
+      compressed->bytes -= edit.data.length();
+      std::string().swap(edit.data);
+    }
+  }
+  /** Returns the compressed edits of the document, or null if it has none. */
+  CompressedUndo *ScintillaTermbox::FindCompressedUndo() {
+    auto it = compressedUndos.find(pdoc);
+    return it != compressedUndos.end() ? &it->second : nullptr;
+  }
+  /**
+   * Returns the compressed edit with the given undo action token, or null if the token belongs
+   * to the host.
+   */
+  CompressedEdit *ScintillaTermbox::FindCompressedEdit(Sci::Position token) {
+    if (CompressedUndo *compressed = FindCompressedUndo())
+      for (CompressedEdit &edit : compressed->edits)
+        if (reinterpret_cast<Sci::Position>(&edit) == token) return &edit;
+    return nullptr;
+  }
+  /**
+   * Undoes or redoes the compressed edit whose container undo action Scintilla just performed.
+   * Every view of the document records the pending edit, and the view that performed the undo
+   * or redo applies it.
+   */
+  void ScintillaTermbox::ApplyPendingUndo() {
+    CompressedUndo *compressed = FindCompressedUndo();
+    if (!compressed || !compressed->pending) return;
+    const auto [editPtr, undo] = *compressed->pending;
+    compressed->pending.reset();
+    CompressedEdit &edit = *editPtr;
+    edit.undone = undo;
+    const std::string text = CompressedEditText(edit, undo);
+    const bool collectingUndo = pdoc->IsCollectingUndo();
+    pdoc->SetUndoCollection(false);
+    pdoc->DeleteChars(edit.position, undo ? edit.insertedLength : edit.removedLength);
+    pdoc->InsertString(edit.position, text.data(), text.length());
+    pdoc->SetUndoCollection(collectingUndo);
+    SetEmptySelection(edit.position + text.length());
+    EnsureCaretVisible();
+  }
+  /**
+   * Discards undone compressed edits once Scintilla has discarded its redo history.
+   * Spilled text stays in the spill file until all edits are cleared.
+   */
+  void ScintillaTermbox::PruneCompressedEdits() {
+    CompressedUndo *compressed = FindCompressedUndo();
+    if (!compressed || pdoc->CanRedo()) return;
+    compressed->edits.remove_if([compressed](const CompressedEdit &edit) {
+      if (edit.undone) compressed->bytes -= edit.data.length();
+      return edit.undone;
+    });
+  }
+  /** Discards all compressed edits of the document, along with the spill file. */
+  void ScintillaTermbox::ClearCompressedEdits() { compressedUndos.erase(pdoc); }
+  /** Discards the document's undo history, including its compressed edits. */
+  void ScintillaTermbox::DeleteUndoHistory() {
+    pdoc->DeleteUndoHistory();
+    ClearCompressedEdits();
+  }
+  /**
+   * Sets the minimum total length of removed and inserted text for an edit to be stored
+   * compressed, or `0` to disable compressed undo, and how many bytes of compressed text are
+   * kept in memory before older edits spill to a temporary file.
+   */
+  void ScintillaTermbox::SetCompressedUndo(size_t threshold, size_t memory) {
+    compressedUndoThreshold = threshold;
+    compressedUndoMemory = memory;
+    SpillCompressedEdits();
+  }
+  /**
+   * Replaces all matches of the given text or regular expression in the given range.
+   * The result is built in one buffer and replaces the text from the first match to the last as
+   * a single edit and undo action, so large edits also benefit from compressed undo outside of
+   * the host's undo groups. Markers, fold levels and expansion, and line states of the lines in
+   * between are restored if the replacements keep the number of lines. Literal
+   * case-sensitive searches scan the document text directly.
+   * @return the number of replacements
+   */
+  int ScintillaTermbox::ReplaceAll(const char *find, const char *replace, FindOption flags,
+    Sci::Position start, Sci::Position end) {
+    end = end < 0 ? pdoc->Length() : std::min(end, pdoc->Length());
+    start = std::clamp<Sci::Position>(start, 0, end);
+    const std::string_view needle(find);
+    if (needle.empty() || pdoc->IsReadOnly()) return 0;
+    const bool regex = static_cast<int>(flags) & static_cast<int>(FindOption::RegExp);
+    const char *text = pdoc->RangePointer(start, end - start); // moves the gap out of the range
+    std::string result;
+    Sci::Position first = -1, last = start; // range of text replaced and end of the last match
+    int count = 0;
+    auto addMatch = [&](Sci::Position pos, Sci::Position length, std::string_view replacement) {
+      if (first < 0) first = last = pos;
+      result.append(text + (last - start), pos - last);
+      result.append(replacement);
+      last = pos + length, count++;
+    };
+    if (flags == FindOption::MatchCase) {
+      const std::string_view haystack(text, end - start);
+      for (size_t pos = haystack.find(needle); pos != std::string_view::npos;
+           pos = haystack.find(needle, pos + needle.length()))
+        addMatch(start + pos, needle.length(), replace);
+    } else
+      for (Sci::Position pos = start; pos <= end; ) {
+        Sci::Position length = needle.length(); // FindText() reads the search length from here
+        pos = pdoc->FindText(pos, end, find, flags, &length);
+        if (pos < 0 || (length == 0 && !regex)) break; // only regexes match empty text
+        Sci::Position replacementLength = strlen(replace);
+        const char *replacement =
+          regex ? pdoc->SubstituteByPosition(replace, &replacementLength) : replace;
+        addMatch(pos, length, std::string_view(replacement, replacementLength));
+        pos = length > 0 ? pos + length : pdoc->NextPosition(pos, 1);
+        if (length == 0 && pos >= end) break;
+      }
+    if (count == 0) return 0;
+    // Replacing the span deletes its lines, which merges their markers into the first line and
+    // drops their fold levels, line states, and fold expansion, so save those.
+    auto send = [this](Message msg, uptr_t wParam, sptr_t lParam) {
+      return ScintillaBase::WndProc(msg, wParam, lParam);
+    };
+    struct LineData {
+      int markers, level, state;
+      bool expanded;
+    };
+    const Sci::Line lineFirst = pdoc->SciLineFromPosition(first);
+    const Sci::Line lineLast = pdoc->SciLineFromPosition(last);
+    std::vector<LineData> lineData;
+    for (Sci::Line line = lineFirst; line <= lineLast; line++)
+      lineData.push_back({static_cast<int>(send(Message::MarkerGet, line, 0)),
+        static_cast<int>(send(Message::GetFoldLevel, line, 0)),
+        static_cast<int>(send(Message::GetLineState, line, 0)),
+        send(Message::GetFoldExpanded, line, 0) != 0});
+    // Replace through the target so the edit takes the same path as the host's, but leave the
+    // host's target as it was.
+    const SelectionSegment target = targetRange;
+    WndProc(Message::SetTargetRange, first, last);
+    WndProc(Message::ReplaceTarget, result.length(), reinterpret_cast<sptr_t>(result.data()));
+    // Lines only correspond if the replacements kept the number of lines in the span.
+    if (pdoc->SciLineFromPosition(first + result.length()) == lineLast) {
+      const int historyMarkers = 0xF << 21; // change history markers are not the host's
+      for (Sci::Line line = lineFirst; line <= lineLast; line++) {
+        const LineData &data = lineData[line - lineFirst];
+        const int markers = data.markers & ~historyMarkers;
+        if ((send(Message::MarkerGet, line, 0) & ~historyMarkers) != markers) {
+          send(Message::MarkerDelete, line, -1);
+          send(Message::MarkerAddSet, line, markers);
+        }
+        send(Message::SetFoldLevel, line, data.level);
+        send(Message::SetLineState, line, data.state);
+        if ((send(Message::GetFoldExpanded, line, 0) != 0) != data.expanded)
+          send(Message::SetFoldExpanded, line, data.expanded);
+      }
+    }
+    targetRange = target;
+    targetRange.start.SetPosition(std::min(targetRange.start.Position(), pdoc->Length()));
+    targetRange.end.SetPosition(std::min(targetRange.end.Position(), pdoc->Length()));
+    return count;
+  }
+  /**
+   * Restores the caches of a suspended instance and marks it for repainting.
+   * The surface is reallocated on the next refresh.
+   */
+  void ScintillaTermbox::Resume() {
+    if (suspendedPositionCache < 0) return;
+    WndProc(Message::SetPositionCache, suspendedPositionCache, 0);
+    suspendedPositionCache = -1;
+    Invalidate();
+  }
   /** Deletes the Scintilla instance. */
   ScintillaTermbox::~ScintillaTermbox() {
+    // The document is deleted with this instance if it holds the last reference.
+    pdoc->AddRef();
+    if (pdoc->Release() == 1) ClearCompressedEdits();
+    if (cursorShapeSender != this) return;
+    if (sentCursorShape != 0) SendCursorShape(0); // default cursor shape
+    cursorShapeSender = nullptr;
   }
   /** Initializing code is unnecessary. */
   void ScintillaTermbox::Initialise() { }
@@ -279,48 +1156,81 @@ public:
    inDragDrop = DragDrop::none;
     SetDragPosition(SelectionPosition(Sci::invalidPosition));
   }
-  /** Draws the vertical scroll bar. */
+  /**
+   * Draws the vertical scroll bar.
+   * The ends of the bar are drawn with eighth block characters so its position is exact even
+   * for huge documents. Only the cells that differ from the bar already on screen are drawn.
+   */
   void ScintillaTermbox::SetVerticalScrollPos() {
     if (!verticalScrollBarVisible) return;
     int maxy = reinterpret_cast<TermboxWin *>(wMain.GetID())->Height();
-    int maxx = reinterpret_cast<TermboxWin *>(wMain.GetID())->Width();
-    int left = reinterpret_cast<TermboxWin *>(wMain.GetID())->left;
+    int right = reinterpret_cast<TermboxWin *>(wMain.GetID())->right;
     int top = reinterpret_cast<TermboxWin *>(wMain.GetID())->top;
-    // Draw the gutter.
-    for (int i = 0; i < maxy; i++) tb_change_cell(left + maxx - 1, top + i, ' ', 0x282828, 0x282828);
-    // Draw the bar.
-    scrollBarVPos = static_cast<float>(topLine) / (MaxScrollPos() + LinesOnScreen() - 1) * maxy;
-    for (int i = scrollBarVPos; i < scrollBarVPos + scrollBarHeight; i++)
-      tb_change_cell(left + maxx - 1, top + i, ' ', 0xd8d8d8, 0xd8d8d8);
-  }
-  /** Draws the horizontal scroll bar. */
+    Sci::Line lines = MaxScrollPos() + LinesOnScreen() - 1 + UnwrappedLinesEstimate();
+    lines = std::max<Sci::Line>(lines, 1);
+    int start = static_cast<float>(topLine) / lines * maxy * 8;
+    start = std::clamp(start, 0, std::max(maxy * 8 - scrollBarHeight8, 0));
+    int end = start + scrollBarHeight8;
+    scrollBarVPos = start / 8;
+    if (drawnVBar.size() != static_cast<size_t>(maxy)) drawnVBar.assign(maxy, tb_cell{});
+    for (int i = 0; i < maxy; i++) {
+      int covered = std::min(end, i * 8 + 8) - std::max(start, i * 8); // eighths of the bar
+      tb_cell cell{' ', 0x282828, 0x282828}; // gutter
+      if (covered >= 8)
+        cell.fg = cell.bg = 0xd8d8d8; // bar
+      else if (covered > 0 && start > i * 8)
+        cell = {static_cast<uint32_t>(0x2580 + covered), 0xd8d8d8, 0x282828}; // top of the bar
+      else if (covered > 0)
+        cell = {static_cast<uint32_t>(0x2588 - covered), 0x282828, 0xd8d8d8}; // bottom of the bar
+      tb_cell &drawn = drawnVBar[i];
+      if (drawn.ch == cell.ch && drawn.fg == cell.fg && drawn.bg == cell.bg) continue;
+      tb_change_cell(right, top + i, cell.ch, cell.fg, cell.bg);
+      drawn = cell;
+    }
+  }
+  /**
+   * Draws the horizontal scroll bar.
+   * Only the cells that differ from the bar already on screen are drawn.
+   */
   void ScintillaTermbox::SetHorizontalScrollPos() {
     if (!horizontalScrollBarVisible) return;
-    int maxy = reinterpret_cast<TermboxWin *>(wMain.GetID())->Height();
     int maxx = reinterpret_cast<TermboxWin *>(wMain.GetID())->Width();
     int left = reinterpret_cast<TermboxWin *>(wMain.GetID())->left;
-    int top = reinterpret_cast<TermboxWin *>(wMain.GetID())->top;
-    // Draw the gutter.
-//    wattr_set(w, 0, term_color_pair(COLOR_WHITE, COLOR_BLACK), nullptr);
-    for (int i = 0; i < maxx; i++) tb_change_cell(left + i, top + maxy - 1, ' ', 0x282828, 0x282828);
-    // Draw the bar.
+    int bottom = reinterpret_cast<TermboxWin *>(wMain.GetID())->bottom;
+    if (verticalScrollBarVisible) maxx--; // the vertical scroll bar owns the corner
     scrollBarHPos = static_cast<float>(xOffset) / scrollWidth * maxx;
-//    wattr_set(w, 0, term_color_pair(COLOR_BLACK, COLOR_WHITE), nullptr);
-    for (int i = scrollBarHPos; i < scrollBarHPos + scrollBarWidth; i++)
-      tb_change_cell(left + i, top + maxy - 1, ' ', 0xd8d8d8, 0xd8d8d8);
+    scrollBarHPos = std::clamp(scrollBarHPos, 0, std::max(maxx - scrollBarWidth, 0));
+    int first = 0, last = maxx; // cells to update
+    if (drawnHPos >= 0) {
+      if (drawnHPos == scrollBarHPos && drawnHWidth == scrollBarWidth) return;
+      first = std::min(drawnHPos, scrollBarHPos);
+      last = std::min(std::max(drawnHPos + drawnHWidth, scrollBarHPos + scrollBarWidth), maxx);
+    }
+    for (int i = first; i < last; i++) {
+      bool bar = i >= scrollBarHPos && i < scrollBarHPos + scrollBarWidth;
+      bool drawn = i >= drawnHPos && i < drawnHPos + drawnHWidth;
+      if (drawnHPos >= 0 && bar == drawn) continue;
+      int color = bar ? 0xd8d8d8 : 0x282828; // bar or gutter
+      tb_change_cell(left + i, bottom, ' ', color, color);
+    }
+    drawnHPos = scrollBarHPos, drawnHWidth = scrollBarWidth;
   }
   /**
    * Sets the height of the vertical scroll bar and width of the horizontal scroll bar.
    * The height is based on the given size of a page and the total number of pages. The width
    * is based on the width of the view and the view's scroll width property.
+   * @return whether or not either scroll bar changed size
    */
   bool ScintillaTermbox::ModifyScrollBars(Sci::Line nMax, Sci::Line nPage) {
     int maxy = reinterpret_cast<TermboxWin *>(wMain.GetID())->Height();
     int maxx = reinterpret_cast<TermboxWin *>(wMain.GetID())->Width();
-    int height = roundf(static_cast<float>(nPage) / nMax * maxy);
-    scrollBarHeight = std::clamp(height, 1, maxy);
+    if (verticalScrollBarVisible) maxx--; // the vertical scroll bar owns the corner
+    nMax += UnwrappedLinesEstimate();
+    int height8 = roundf(static_cast<float>(nPage) / nMax * maxy * 8);
     int width = roundf(static_cast<float>(maxx) / scrollWidth * maxx);
-    scrollBarWidth = std::clamp(width, 1, maxx);
+    height8 = std::clamp(height8, 8, maxy * 8), width = std::clamp(width, 1, maxx);
+    if (height8 == scrollBarHeight8 && width == scrollBarWidth) return false;
+    scrollBarHeight8 = height8, scrollBarHeight = (height8 + 7) / 8, scrollBarWidth = width;
     return true;
   }
   /**
@@ -344,10 +1254,56 @@ public:
   void ScintillaTermbox::NotifyChange() {}
   /** Send Scintilla notifications to the parent. */
   void ScintillaTermbox::NotifyParent(NotificationData scn) {
+    // The container may change what is drawn on the caret line in response, as with
+    // `SCN_KEY`. `SCN_UPDATEUI` and `SCN_PAINTED` are sent while painting, after a key press
+    // decided its repaint, and changes made in response invalidate as usual.
+    if (scn.nmhdr.code != Notification::UpdateUI && scn.nmhdr.code != Notification::Painted)
+      contentChanged = true;
     if (callback)
       (*callback)(
         reinterpret_cast<void *>(this), 0, reinterpret_cast<SCNotification *>(&scn), userdata);
   }
+  /**
+   * Keeps lexer checkpoints in step with inserted and deleted lines.
+   * Checkpoints after the modified line are no longer exact, but are kept as starting points
+   * for speculative lexing.
+   */
+  void ScintillaTermbox::NotifyModified(Document *document, DocModification mh, void *userData) {
+    ScintillaBase::NotifyModified(document, mh, userData);
+    contentChanged = true;
+    const int modificationType = static_cast<int>(mh.modificationType);
+    const int undo = static_cast<int>(ModificationFlags::Undo);
+    const int redo = static_cast<int>(ModificationFlags::Redo);
+    if ((modificationType & static_cast<int>(ModificationFlags::Container)) &&
+      (modificationType & (undo | redo)))
+      if (CompressedEdit *edit = FindCompressedEdit(mh.token))
+        // The document cannot be modified from here, so apply the edit once undo or redo
+        // returns.
+        FindCompressedUndo()->pending.emplace(edit, (modificationType & undo) != 0);
+    const int textChanged = static_cast<int>(ModificationFlags::InsertText) |
+      static_cast<int>(ModificationFlags::DeleteText);
+    if ((modificationType & textChanged) && (modificationType & (undo | redo)) == 0 &&
+      pdoc->IsCollectingUndo() && FindCompressedUndo())
+      PruneCompressedEdits(); // new edits discard redo history
+    if (maxLines > 0 && mh.linesAdded > 0 && pdoc->LinesTotal() > maxLines + maxLines / 4 &&
+      (modificationType & (undo | redo)) == 0) // undoing a trim restores the lines
+      trimPending = true; // the document cannot be modified from here
+    if ((modificationType & textChanged) && mh.position < speculativeEnd)
+      speculativeEnd = 0; // the speculatively styled range moved
+    if (checkpointInterval <= 0 || (static_cast<int>(mh.modificationType) & textChanged) == 0)
+      return;
+    const Sci::Line line = pdoc->SciLineFromPosition(mh.position);
+    checkpointsExactTo = std::min(checkpointsExactTo, line);
+    if (mh.linesAdded == 0) return;
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), line, CheckpointAfter);
+    if (mh.linesAdded < 0) {
+      // Drop checkpoints whose lines were deleted.
+      auto last = std::upper_bound(it, checkpoints.end(), line - mh.linesAdded,
+        CheckpointAfter);
+      it = checkpoints.erase(it, last);
+    }
+    for (; it != checkpoints.end(); it++) it->line += mh.linesAdded;
+  }
   /**
    * Handles an unconsumed key.
    * If a character is being typed, add it to the editor. Otherwise, notify the container.
@@ -358,11 +1314,17 @@ public:
         char utf8[6];
         int len;
         toutf8(static_cast<int>(key), utf8, &len);
-        InsertCharacter(std::string(utf8, len), CharacterSource::DirectInput);
+        if (InsertAtCarets(std::string_view(utf8, len)))
+          NotifyChar(static_cast<int>(key), CharacterSource::DirectInput);
+        else
+          InsertCharacter(std::string(utf8, len), CharacterSource::DirectInput);
         return 1;
       } else {
         char ch = static_cast<char>(key);
-        InsertCharacter(std::string(&ch, 1), CharacterSource::DirectInput);
+        if (InsertAtCarets(std::string_view(&ch, 1)))
+          NotifyChar(static_cast<unsigned char>(ch), CharacterSource::DirectInput);
+        else
+          InsertCharacter(std::string(&ch, 1), CharacterSource::DirectInput);
         return 1;
       }
     } else {
@@ -373,17 +1335,103 @@ public:
       return (NotifyParent(scn), 0);
     }
   }
+  /**
+   * Types the given text at every caret of a multiple selection in one sweep, replacing any
+   * selected text.
+   * Scintilla's `InsertCharacter()` inserts at each caret in turn and moves every selection
+   * after each insertion, which is quadratic in the number of carets. Instead, the selections are
+   * detached, the text is inserted from the last caret to the first in one undo group, and the
+   * selections are rebuilt at their new positions. The container receives the usual
+   * `SCN_MODIFIED` notifications for each range, and the text is recorded as one macro step.
+   * Carets are placed after the text each insertion actually added, which differs if the
+   * container changed it with `SCI_CHANGEINSERTION`.
+   * @return whether or not the text was typed, or `false` if `InsertCharacter()` is needed for
+   *   rectangular selections, virtual space, protected text, overtype, or autocompletion
+   */
+  bool ScintillaTermbox::InsertAtCarets(std::string_view text) {
+    if (sel.Count() < 2 || sel.IsRectangular() || inOverstrike || !additionalSelectionTyping ||
+      ac.Active() || pdoc->IsReadOnly())
+      return false;
+    std::vector<std::pair<SelectionSegment, size_t>> ranges; // ranges and selection indices
+    for (size_t r = 0; r < sel.Count(); r++) {
+      const SelectionRange &range = sel.Range(r);
+      if (range.caret.VirtualSpace() || range.anchor.VirtualSpace() ||
+        RangeContainsProtected(range.Start().Position(), range.End().Position()))
+        return false;
+      ranges.emplace_back(SelectionSegment(range.caret, range.anchor), r);
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const auto &a, const auto &b) {
+      return a.first.start < b.first.start;
+    });
+    for (size_t i = 1; i < ranges.size(); i++)
+      if (ranges[i].first.start < ranges[i - 1].first.end) return false; // overlapping
+    const size_t mainRange = sel.Main();
+    sel.SetSelection(SelectionRange(0)); // detach the selections so they are not moved
+    std::vector<std::pair<Sci::Position, Sci::Position>> changes(ranges.size()); // lengths
+    {
+      UndoGroup ug(pdoc);
+      for (size_t i = ranges.size(); i-- > 0;) {
+        const Sci::Position start = ranges[i].first.start.Position();
+        const Sci::Position length = ranges[i].first.end.Position() - start;
+        const Sci::Position removed = pdoc->DeleteChars(start, length) ? length : 0;
+        changes[i] = {removed, pdoc->InsertString(start, text.data(), text.length())};
+      }
+    }
+    // Rebuild the selections as carets after each insertion.
+    Sci::Position shift = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+      const auto [removed, inserted] = changes[i];
+      const SelectionRange caret(ranges[i].first.start.Position() + shift + inserted);
+      shift += inserted - removed;
+      if (i == 0)
+        sel.SetSelection(caret);
+      else
+        sel.AddSelection(caret);
+      if (ranges[i].second == mainRange) sel.SetMain(i);
+    }
+    if (recordingMacro) {
+      const std::string copy(text); // null-terminated
+      NotifyMacroRecord(Message::ReplaceSel, 0, reinterpret_cast<sptr_t>(copy.c_str()));
+    }
+    // As in InsertCharacter(), rewrap the main caret's line right away.
+    if (Wrapping()) {
+      AutoSurface surface(this);
+      if (surface && WrapOneLine(surface, pdoc->SciLineFromPosition(sel.MainCaret())))
+        SetScrollBars(), SetVerticalScrollPos();
+    }
+    Redraw();
+    SetLastXChosen();
+    EnsureCaretVisible();
+    ShowCaretAtCurrentPosition(); // restart the blink with the caret visible
+    return true;
+  }
   /**
    * Copies the given text to the internal clipboard.
    * Like `Copy()`, does not affect the primary and secondary X selections.
    */
   void ScintillaTermbox::CopyToClipboard(const SelectionText &selectedText) { clipboard.Copy(selectedText); }
-  /** A ticking caret is not implemented. */
-  bool ScintillaTermbox::FineTickerRunning(TickReason reason) { return false; }
-  /** A ticking caret is not implemented. */
-  void ScintillaTermbox::FineTickerStart(TickReason reason, int millis, int tolerance) {}
-  /** A ticking caret is not implemented. */
-  void ScintillaTermbox::FineTickerCancel(TickReason reason) {}
+  /**
+   * Idle work like idle styling and background wrapping is only queued once the application
+   * has started calling `scintilla_tick()`. Otherwise it is performed synchronously.
+   */
+  bool ScintillaTermbox::SetIdle(bool on) {
+    if (!ticking) return false;
+    idler.state = on;
+    return true;
+  }
+  /**
+   * Returns whether or not the given ticker is running.
+   * Tickers only fire once the application calls `scintilla_tick()`.
+   */
+  bool ScintillaTermbox::FineTickerRunning(TickReason reason) {
+    return fineTickers.count(reason) > 0;
+  }
+  /** Starts the given ticker, firing it every *millis* milliseconds from `Tick()`. */
+  void ScintillaTermbox::FineTickerStart(TickReason reason, int millis, int tolerance) {
+    fineTickers[reason] = FineTicker{Now() + millis, std::max(millis, 1)};
+  }
+  /** Stops the given ticker. */
+  void ScintillaTermbox::FineTickerCancel(TickReason reason) { fineTickers.erase(reason); }
   /**
    * Sets whether or not the mouse is captured.
    * This is used by Scintilla to handle mouse clicks, drags, and releases.
@@ -428,18 +1476,163 @@ public:
           tb_change_cell(x, y, ' ', bg, bg);
         }
       }
-      ct.PaintCT(sur.get());
-      tb_present();
+      ct.PaintCT(sur.get()); // presented with the rest of the frame
     }
   }
   /** Adding menu items to the popup menu is not implemented. */
   void ScintillaTermbox::AddToPopUp(const char *label, int cmd, bool enabled) {}
+  /**
+   * Records a lexer checkpoint every `checkpointInterval` lines of the styled part of the
+   * document.
+   */
+  void ScintillaTermbox::UpdateCheckpoints() {
+    if (checkpointInterval <= 0) return;
+    const Sci::Line lineEndStyled = pdoc->SciLineFromPosition(pdoc->GetEndStyled());
+    if (lineEndStyled <= checkpointsExactTo) return;
+    // Exact checkpoints replace any speculative ones in the newly styled range.
+    auto first = std::upper_bound(
+      checkpoints.begin(), checkpoints.end(), checkpointsExactTo, CheckpointAfter);
+    auto last = std::upper_bound(first, checkpoints.end(), lineEndStyled, CheckpointAfter);
+    std::vector<LexerCheckpoint> styled;
+    for (Sci::Line line = (checkpointsExactTo / checkpointInterval + 1) * checkpointInterval;
+         line <= lineEndStyled; line += checkpointInterval)
+      styled.push_back(
+        {line, pdoc->GetLineState(line - 1), pdoc->StyleAt(pdoc->LineStart(line) - 1)});
+    checkpoints.insert(checkpoints.erase(first, last), styled.begin(), styled.end());
+    checkpointsExactTo = lineEndStyled;
+  }
+  /**
+   * When the view is far beyond the styled part of the document, lexes the visible lines from
+   * the nearest checkpoint instead of from `GetEndStyled()`.
+   * The end of styling is restored afterwards so idle styling still corrects the visible lines
+   * if the checkpoint turns out to be stale. The lexed range is remembered so later refreshes do
+   * not lex it again, unless the text moves or styling is invalidated in the meantime.
+   */
+  void ScintillaTermbox::StyleFromCheckpoint() {
+    if (checkpoints.empty() || !ticking) return;
+    if (idleStyling != IdleStyling::ToVisible && idleStyling != IdleStyling::All) return;
+    const LexInterface *lexer = pdoc->GetLexInterface();
+    if (!lexer || lexer->UseContainerLexing()) return;
+    const Sci::Line lineTop = pcs->DocFromDisplay(topLine);
+    const Sci::Position endStyled = pdoc->GetEndStyled();
+    const Sci::Line lineEndStyled = pdoc->SciLineFromPosition(endStyled);
+    if (lineTop - lineEndStyled <= checkpointInterval) return; // close enough to lex normally
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), lineTop, CheckpointAfter);
+    if (it == checkpoints.begin() || (--it)->line <= lineEndStyled ||
+      it->line >= pdoc->LinesTotal())
+      return;
+    const Sci::Position start = pdoc->LineStart(it->line);
+    const Sci::Line lineBottom = pcs->DocFromDisplay(topLine + LinesOnScreen());
+    const Sci::Position end = pdoc->LineStart(std::min(lineBottom + 1, pdoc->LinesTotal()));
+    if (start >= speculativeStart && end <= speculativeEnd &&
+      endStyled >= speculativeEndStyled)
+      return; // already styled speculatively
+    pdoc->SetLineState(it->line - 1, it->lineState);
+    pdoc->StartStyling(start - 1);
+    pdoc->SetStyleFor(1, it->style);
+    ScintillaBase::WndProc(Message::Colourise, start, end);
+    pdoc->StartStyling(endStyled);
+    speculativeStart = start, speculativeEnd = end, speculativeEndStyled = endStyled;
+  }
+  /**
+   * Scrolls the view horizontally by the given number of columns.
+   * Unlike `HorizontalScrollTo()`, only the text area is repainted since margins do not scroll.
+   */
+  void ScintillaTermbox::ScrollColumns(int columns) {
+    if (Wrapping()) return;
+    int maxOffset = std::max(scrollWidth - static_cast<int>(GetTextRectangle().Width()), 0);
+    int xPos = std::clamp(xOffset + columns, 0, std::max(maxOffset, xOffset));
+    if (xPos == xOffset) return;
+    xOffset = xPos;
+    ContainerNeedsUpdate(Update::HScroll);
+    SetHorizontalScrollPos();
+    RedrawRect(GetTextRectangle());
+  }
+  /**
+   * Scrolls the view horizontally in the given direction, doubling the number of columns
+   * scrolled while scroll events arrive in quick succession.
+   * @param direction `-1` to scroll left or `1` to scroll right.
+   * @param time The time of the scroll event in milliseconds.
+   */
+  void ScintillaTermbox::AccelerateHorizontalScroll(int direction, unsigned int time) {
+    int minStep = 4, maxStep = std::max(GetWINDOW()->Width() / 2, minStep);
+    if (time - lastHScrollTime < 100 && hScrollStep * direction > 0)
+      hScrollStep = std::clamp(hScrollStep * 2, -maxStep, maxStep);
+    else
+      hScrollStep = minStep * direction;
+    lastHScrollTime = time;
+    ScrollColumns(hScrollStep);
+  }
+  /**
+   * Returns an estimate of the number of extra display lines that lines still waiting to be
+   * wrapped in the background will add once wrapped.
+   * The estimate is based on the average number of display lines per document line wrapped so
+   * far, so the scroll bars become progressively more accurate as wrapping proceeds.
+   */
+  Sci::Line ScintillaTermbox::UnwrappedLinesEstimate() {
+    if (!Wrapping() || !wrapPending.NeedsWrap()) return 0;
+    const Sci::Line wrapped = std::min(wrapPending.start, pdoc->LinesTotal());
+    if (wrapped <= 0) return 0;
+    const double linesPerLine = static_cast<double>(pcs->DisplayFromDoc(wrapped)) / wrapped;
+    const Sci::Line unwrapped = std::min(wrapPending.end, pdoc->LinesTotal()) - wrapped;
+    return std::max<Sci::Line>(static_cast<Sci::Line>(unwrapped * (linesPerLine - 1)), 0);
+  }
+  /**
+   * Enters or leaves long line mode depending on whether or not a visible line is long.
+   * Scintilla normally only keeps the layout of the caret line between paints, so every other
+   * visible long line is measured in full on each paint. In long line mode, the layouts of all
+   * visible lines are kept until they change, and painting only touches the visible columns
+   * of each line since `LineLayout` already maps positions to columns in constant time.
+   * A long line is still laid out in full whenever it changes, since Scintilla's layout cannot
+   * be split into chunks from the platform layer.
+   * The host's layout cache setting is kept in `normalLayoutCache` while in long line mode and
+   * restored when leaving it.
+   */
+  void ScintillaTermbox::UpdateLongLineMode() {
+    bool longLine = false;
+    if (longLineLength > 0) {
+      const Sci::Line lineTop = pcs->DocFromDisplay(topLine);
+      const Sci::Line lineBottom = pcs->DocFromDisplay(topLine + LinesOnScreen());
+      for (Sci::Line line = lineTop; line <= lineBottom && !longLine; line++)
+        longLine = pdoc->LineEnd(line) - pdoc->LineStart(line) >= longLineLength;
+    }
+    if (longLine == (normalLayoutCache >= 0)) return;
+    if (longLine) {
+      normalLayoutCache = ScintillaBase::WndProc(Message::GetLayoutCache, 0, 0);
+      if (normalLayoutCache < static_cast<int>(LineCache::Page))
+        ScintillaBase::WndProc(Message::SetLayoutCache, static_cast<uptr_t>(LineCache::Page), 0);
+    } else {
+      const int layoutCache = normalLayoutCache;
+      normalLayoutCache = -1;
+      ScintillaBase::WndProc(Message::SetLayoutCache, layoutCache, 0);
+    }
+  }
+  /**
+   * Applies the next frame of wheel scrolling accumulated in `pendingScroll`, if it is due.
+   * With easing, half of the remaining distance is scrolled per frame so the view decelerates
+   * smoothly. Otherwise, everything accumulated since the last frame is scrolled at once.
+   * @param time The current time in milliseconds.
+   * @return whether or not the view scrolled
+   */
+  bool ScintillaTermbox::ScrollFrame(unsigned int time) {
+    if (pendingScroll == 0 || time - lastScrollFrame < frameInterval) return false;
+    lastScrollFrame = time;
+    Sci::Line lines = pendingScroll;
+    if (scrollEasing && std::abs(lines) > 1) lines /= 2;
+    const Sci::Line prevTopLine = topLine;
+    ScrollTo(topLine + lines);
+    pendingScroll = topLine != prevTopLine ? pendingScroll - lines : 0; // stop at either end
+    return topLine != prevTopLine;
+  }
   /**
    * Sends the given message and parameters to Scintilla unless it is a message that changes
    * an unsupported property.
    */
   sptr_t ScintillaTermbox::WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) {
     try {
+      // Queued followed text was appended before this message, so the message must see it and
+      // edits must land after it.
+      if (!followText.empty()) FlushFollow();
       switch (iMessage) {
       case Message::GetDirectFunction: return reinterpret_cast<sptr_t>(scintilla_send_message);
       case Message::GetDirectPointer: return reinterpret_cast<sptr_t>(this);
@@ -449,9 +1642,50 @@ public:
       case Message::SetPhasesDraw:
       case Message::SetExtraAscent:
       case Message::SetExtraDescent: return 0;
+      case Message::SetDocPointer: {
+        // Compressed edits stay with the old document's undo history until it is deleted.
+        Document *old = pdoc;
+        old->AddRef();
+        const sptr_t result = ScintillaBase::WndProc(iMessage, wParam, lParam);
+        if (old->Release() == 0) compressedUndos.erase(old);
+        SetCheckpointInterval(checkpointInterval); // checkpoints belong to the old document
+        ResetAnsiStyles(); // and so do the styles text was styled with
+        return result;
+      }
+      case Message::StyleClearAll: {
+        const sptr_t result = ScintillaBase::WndProc(iMessage, wParam, lParam);
+        ResetAnsiStyles();
+        return result;
+      }
+      case Message::ReplaceTarget:
+      case Message::ReplaceSel:
+      case Message::DeleteRange:
+      case Message::ClearAll:
+      case Message::SetText:
+        if (auto result = CompressedEditMessage(iMessage, wParam, lParam)) return *result;
+        return ScintillaBase::WndProc(iMessage, wParam, lParam);
+      case Message::Undo:
+      case Message::Redo: {
+        const sptr_t result = ScintillaBase::WndProc(iMessage, wParam, lParam);
+        ApplyPendingUndo();
+        return result;
+      }
+      case Message::BeginUndoAction: undoGroupDepth++; break;
+      case Message::EndUndoAction: undoGroupDepth = std::max(undoGroupDepth - 1, 0); break;
+      case Message::EmptyUndoBuffer: ClearCompressedEdits(); break;
+      // Long line mode raises the layout cache level until it is left.
+      case Message::GetLayoutCache:
+        if (normalLayoutCache >= 0) return normalLayoutCache;
+        break;
+      case Message::SetLayoutCache:
+        if (normalLayoutCache < 0) break;
+        normalLayoutCache = static_cast<int>(wParam);
+        return ScintillaBase::WndProc(
+          iMessage, std::max(wParam, static_cast<uptr_t>(LineCache::Page)), lParam);
       // Pass to Scintilla.
       default: return ScintillaBase::WndProc(iMessage, wParam, lParam);
       }
+      return ScintillaBase::WndProc(iMessage, wParam, lParam);
     } catch (std::bad_alloc &) {
       errorStatus = Status::BadAlloc;
     } catch (...) {
@@ -468,46 +1702,213 @@ public:
   }
   /**
    * Updates the cursor position, even if it's not visible, as the container may have a use for it.
+   * The new position is shown the next time the screen is presented.
    */
   void ScintillaTermbox::UpdateCursor() {
-    int pos = WndProc(Message::GetCurrentPos, 0, 0);
-    if (!WndProc(Message::GetSelectionEmpty, 0, 0) &&
-      (WndProc(Message::GetCaretStyle, 0, 0) & static_cast<int>(CaretStyle::BlockAfter)) == 0 &&
-      (WndProc(Message::GetCurrentPos, 0, 0) > WndProc(Message::GetAnchor, 0, 0)))
-      pos = WndProc(Message::PositionBefore, pos, 0); // draw inside selection
-    int y = WndProc(Message::PointYFromPosition, 0, pos);
-    int x = WndProc(Message::PointXFromPosition, 0, pos);
+    Sci::Position pos = sel.MainCaret();
+    if (!sel.Empty() &&
+      (static_cast<int>(vs.caret.style) & static_cast<int>(CaretStyle::BlockAfter)) == 0 &&
+      pos > sel.MainAnchor())
+      pos = pdoc->MovePositionOutsideChar(pos - 1, -1, true); // draw inside selection
+    const Point pt = LocationFromPosition(pos);
+    const int x = static_cast<int>(pt.x) - vs.textStart + vs.fixedColumnWidth;
+    const int y = static_cast<int>(pt.y);
 #ifdef DEBUG
-    fprintf(stderr, "update cursor pos = %d, %d, %d\n", pos, GetWINDOW()->left + x, GetWINDOW()->top + y);
+    fprintf(stderr, "update cursor pos = %d, %d, %d\n", static_cast<int>(pos), GetWINDOW()->left + x, GetWINDOW()->top + y);
 #endif
     tb_set_cursor(GetWINDOW()->left + x, GetWINDOW()->top + y);
-    tb_present();
   }
   /**
-   * Repaints the Scintilla window on the physical screen.
+   * Restores the text under the carets drawn by `ShowCarets()`.
+   * Cells that no longer hold the caret, because a popup, another window, or the application
+   * drew over them since, are left alone.
+   */
+  void ScintillaTermbox::HideCarets() {
+    const TermboxWin *w = GetWINDOW();
+    const tb_cell *buffer = tb_cell_buffer();
+    for (auto it = caretCells.rbegin(); it != caretCells.rend(); it++) { // overlapping carets
+      if (it->x < w->left || it->x > w->right || it->y < w->top || it->y > w->bottom ||
+        it->x >= tb_width() || it->y >= tb_height())
+        continue;
+      const tb_cell &cell = buffer[it->y * tb_width() + it->x];
+      if (cell.ch == it->cell.ch && cell.fg == it->fg && cell.bg == it->bg)
+        tb_change_cell(it->x, it->y, it->cell.ch, it->cell.fg, it->cell.bg);
+    }
+    caretCells.clear();
+  }
+  /**
+   * Draws the carets that Scintilla would paint into the text as reversed cells over it, in
+   * the caret colour, according to the caret's blink state.
+   * Blinking and drawing additional carets then only changes these cells instead of
+   * repainting the caret lines. When the caret style is `CaretStyle::Curses`, the main caret
+   * is the terminal's cursor and not drawn. Nothing is drawn while the window is suspended or
+   * not yet painted, since its cells on screen may belong to something else.
+   */
+  void ScintillaTermbox::ShowCarets() {
+    HideCarets();
+    if (suspendedPositionCache >= 0 || lazyInitPending || view.hideSelection ||
+      vs.caret.width <= 0)
+      return;
+    const TermboxWin *w = GetWINDOW();
+    const int style = static_cast<int>(vs.caret.style);
+    const bool curses = style & static_cast<int>(CaretStyle::Curses);
+    const bool invisible = (style & static_cast<int>(CaretStyle::InsMask)) ==
+      static_cast<int>(CaretStyle::Invisible);
+    const bool inside = (style & static_cast<int>(CaretStyle::BlockAfter)) == 0 &&
+      (curses || (style & static_cast<int>(CaretStyle::InsMask)) ==
+      static_cast<int>(CaretStyle::Block));
+    const bool blinkOn = caret.active && caret.on;
+    const bool cursorCaret = hasFocus && CursorShape() != 0; // the terminal draws the main caret
+    const PRectangle rcText = GetTextRectangle();
+    tb_cell *buffer = tb_cell_buffer();
+    for (size_t r = 0; r < sel.Count(); r++) {
+      const bool main = r == sel.Main();
+      if (main ? invisible || !blinkOn || cursorCaret :
+          (invisible && !curses) || !view.additionalCaretsVisible ||
+          (!blinkOn && view.additionalCaretsBlink))
+        continue;
+      const SelectionRange &range = sel.Range(r);
+      SelectionPosition pos = range.caret;
+      if (inside && !range.Empty() && pos > range.anchor) { // draw inside the selection
+        if (pos.VirtualSpace() > 0)
+          pos.SetVirtualSpace(pos.VirtualSpace() - 1);
+        else
+          pos.SetPosition(pdoc->MovePositionOutsideChar(pos.Position() - 1, -1));
+      }
+      const Point pt = LocationFromPosition(pos);
+      if (pt.x < rcText.left || pt.x >= rcText.right || pt.y < rcText.top ||
+        pt.y >= rcText.bottom)
+        continue;
+      const int x = w->left + static_cast<int>(pt.x), y = w->top + static_cast<int>(pt.y);
+      if (x >= tb_width() || y >= tb_height()) continue;
+      const tb_cell cell = buffer[y * tb_width() + x];
+      const Element element = main ? Element::Caret : Element::CaretAdditional;
+      const uint32_t fg = (cell.fg & ~0xFFFFFFu) | (cell.bg & 0xFFFFFFu); // keep attributes
+      const uint32_t bg = to_rgb(vs.ElementColourForced(element));
+      caretCells.push_back(CaretCell{x, y, cell, fg, bg});
+      tb_change_cell(x, y, cell.ch, fg, bg);
+    }
+  }
+  /**
+   * Repaints the parts of the Scintilla window that changed on the physical screen.
    * If an autocompletion list, user list, or calltip is active, redraw it over the buffer's
    * contents.
-   * To paint to the virtual screen instead, use `NoutRefresh()`.
-   * @see NoutRefresh
    */
   void ScintillaTermbox::Refresh() {
-    rcPaint.top = 0;
-    rcPaint.left = 0; // paint from (0, 0), not (begy, begx)
-    rcPaint.bottom = reinterpret_cast<TermboxWin *>(wMain.GetID())->Height();
-    rcPaint.right = reinterpret_cast<TermboxWin *>(wMain.GetID())->Width();
-    if (rcPaint.bottom != height || rcPaint.right != width) {
-      height = rcPaint.bottom;
-      width = rcPaint.right;
+    Resume();
+    LazyInitialise();
+    FlushFollow();
+    if (trimPending) TrimLines();
+    TermboxWin *w = GetWINDOW();
+    if (w->Height() != height || w->Width() != width) {
+      height = w->Height();
+      width = w->Width();
       ChangeSize();
+      w->Invalidate(PRectangle(0, 0, width, height));
+    }
+    // Unless the application opted into partial refreshes, it may have drawn over the window or
+    // cleared the screen, so repaint everything.
+    if (!partialRefresh) Invalidate();
+    // Popups are drawn over the text, so repaint everything while one is or was visible.
+    if (popupVisible || ac.Active() || ct.inCallTipMode)
+      w->Invalidate(PRectangle(0, 0, width, height));
+    popupVisible = ac.Active() || ct.inCallTipMode;
+    StyleFromCheckpoint();
+    UpdateLongLineMode();
+    // Only repaint the areas invalidated since the last refresh, leaving the cells around
+    // each one untouched.
+    std::vector<PRectangle> damage;
+    damage.swap(w->damage);
+    SurfaceImpl *surface = dynamic_cast<SurfaceImpl *>(sur.get());
+    // Carets are drawn over the painted text, so hide them from Scintilla while painting.
+    HideCarets();
+    const int caretWidth = vs.caret.width;
+    vs.caret.width = 0;
+    for (PRectangle rc : damage) {
+      rc.left = std::max(rc.left, 0.0), rc.top = std::max(rc.top, 0.0);
+      rc.right = std::min(rc.right, static_cast<XYPOSITION>(width));
+      rc.bottom = std::min(rc.bottom, static_cast<XYPOSITION>(height));
+      if (rc.Empty()) continue;
+      rcPaint = rc;
+      paintState = PaintState::painting;
+      paintingAllText = rcPaint.Contains(GetClientRectangle());
+      surface->SetPaintClip(rcPaint);
+      Paint(sur.get(), rcPaint);
+      const bool abandoned = paintState == PaintState::abandoned;
+      if (abandoned) {
+        // Styling or highlighting changed outside of the painted area.
+        rcPaint = GetClientRectangle();
+        paintState = PaintState::painting, paintingAllText = true;
+        surface->SetPaintClip(rcPaint);
+        Paint(sur.get(), rcPaint);
+      }
+      paintState = PaintState::notPainting;
+      if (rcPaint.bottom >= height) drawnHPos = -1; // painted over the horizontal scroll bar
+      if (rcPaint.right >= width) { // painted over part of the vertical scroll bar
+        int last = std::min(static_cast<int>(rcPaint.bottom), static_cast<int>(drawnVBar.size()));
+        for (int i = rcPaint.top; i < last; i++) drawnVBar[i] = tb_cell{};
+      }
+      if (abandoned) break; // everything was repainted
+    }
+    surface->SetPaintClip(PRectangle());
+    vs.caret.width = caretWidth;
+    ShowCarets();
+    UpdateCheckpoints();
+    // Scintilla only grows the scroll width while the horizontal scroll bar is visible, which
+    // it is not by default, so grow it here for horizontal scrolling.
+    if (trackLineWidth && view.lineWidthMaxSeen > scrollWidth)
+      scrollWidth = view.lineWidthMaxSeen;
+    if (scrollWidth != lastScrollWidth) {
+      lastScrollWidth = scrollWidth; // a wider line was laid out
+      SetScrollBars();
     }
-    Paint(sur.get(), rcPaint);
     SetVerticalScrollPos(), SetHorizontalScrollPos();
-    tb_present();
     if (ac.Active())
       ac.lb->Select(ac.lb->GetSelection()); // redraw
     else if (ct.inCallTipMode)
       CreateCallTipWindow(PRectangle(0, 0, 0, 0)); // redraw
     if (hasFocus) UpdateCursor();
+    tb_present();
+    if (hasFocus) UpdateCursorShape();
+  }
+  /**
+   * Returns the DECSCUSR shape of the terminal cursor for the main caret, or `0` for the
+   * terminal's default shape.
+   * Line carets are bars and block carets are blocks, or underlines and blocks in overtype
+   * mode. The shape blinks if the caret does. `CaretStyle::Curses` keeps the default shape.
+   */
+  int ScintillaTermbox::CursorShape() {
+    const int style = static_cast<int>(vs.caret.style);
+    if (!cursorShapes || (style & static_cast<int>(CaretStyle::Curses))) return 0;
+    const int insert = style & static_cast<int>(CaretStyle::InsMask);
+    int shape = 0;
+    if (inOverstrike)
+      shape = (style & static_cast<int>(CaretStyle::OverstrikeBlock)) ? 2 : 4;
+    else if (insert == static_cast<int>(CaretStyle::Line))
+      shape = 6;
+    else if (insert == static_cast<int>(CaretStyle::Block))
+      shape = 2;
+    return shape != 0 && caret.period > 0 ? shape - 1 : shape; // odd shapes blink
+  }
+  /**
+   * Sends the cursor shape for the focused window's main caret to the terminal if it changed.
+   * The terminal has one cursor, so the last shape sent is shared by all instances. It is
+   * written after the frame is presented.
+   */
+  void ScintillaTermbox::UpdateCursorShape() {
+    if (!hasFocus) return;
+    cursorShapeSender = this;
+    const int shape = CursorShape();
+    if (shape != sentCursorShape) SendCursorShape(shape);
+  }
+  /**
+   * Marks the whole window for repainting on the next refresh, including the scroll bars.
+   * Scroll bar cells are otherwise only drawn when they change.
+   */
+  void ScintillaTermbox::Invalidate() {
+    Redraw();
+    drawnHPos = -1;
+    drawnVBar.clear();
   }
   /**
    * Sends a key to Scintilla.
@@ -520,7 +1921,38 @@ public:
    * @param shift Flag indicating whether or not the alt modifier key is pressed.
    */
   void ScintillaTermbox::KeyPress(int key, bool shift, bool ctrl, bool alt) {
+    if (!followText.empty()) FlushFollow(); // typed text lands after queued followed text
+    const bool caretOnly = GetWINDOW()->damage.empty() && sel.Count() == 1 && sel.Empty();
+    const Point caret = caretOnly ? LocationFromPosition(sel.RangeMain().caret) : Point();
+    const Sci::Line topBefore = topLine;
+    const int xBefore = xOffset;
+    contentChanged = false;
     KeyDownWithModifiers(static_cast<Keys>(key), ModifierFlags(shift, ctrl, alt), nullptr);
+    ApplyPendingUndo(); // undo and redo keys do not go through WndProc()
+    if (caretOnly && !contentChanged && sel.Count() == 1 && sel.Empty() &&
+      topLine == topBefore && xOffset == xBefore && !ac.Active() && !ct.inCallTipMode)
+      InvalidateCaretMove(caret, LocationFromPosition(sel.RangeMain().caret));
+  }
+  /**
+   * Narrows the repaint after the caret moved and nothing else changed down to the cells the
+   * old and new carets occupy.
+   * Scintilla invalidates the whole old and new caret lines, which is only needed when they
+   * are different lines with a highlighted caret line background, and then left as is.
+   * @param before The caret's previous location relative to this window.
+   * @param after The caret's current location relative to this window.
+   */
+  void ScintillaTermbox::InvalidateCaretMove(Point before, Point after) {
+    TermboxWin *w = GetWINDOW();
+    auto onLine = [this](PRectangle rc, Point caret) {
+      return rc.top >= caret.y && rc.bottom <= caret.y + vs.lineHeight;
+    };
+    for (const PRectangle &rc : w->damage)
+      if (!onLine(rc, before) && !onLine(rc, after)) return; // something else changed too
+    if (before.y != after.y && vs.ElementColour(Element::CaretLineBack)) return;
+    w->damage.clear();
+    // Include the cells either side in case the caret is on or beside a wide character.
+    w->Invalidate(PRectangle(before.x - 1, before.y, before.x + 2, before.y + vs.lineHeight));
+    w->Invalidate(PRectangle(after.x - 1, after.y, after.x + 2, after.y + vs.lineHeight));
   }
   /**
    * Handles a mouse button press.
@@ -533,6 +1965,7 @@ public:
    * @return whether or not the mouse event was handled
    */
   bool ScintillaTermbox::MousePress(int button, int y, int x, bool shift, bool ctrl, bool alt) {
+    if (!followText.empty()) FlushFollow(); // edits from the click land after queued text
     const auto now = std::chrono::system_clock::now().time_since_epoch();
     auto time = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
     if (ac.Active() && (button == 1 || button == 4 || button == 5)) {
@@ -599,9 +2032,9 @@ public:
       } else if (horizontalScrollBarVisible && y == GetWINDOW()->bottom) {
         // Scroll the horizontal scroll bar.
         if (x < scrollBarHPos)
-          return (HorizontalScrollTo(xOffset - GetWINDOW()->right / 2), true);
+          return (ScrollColumns(-GetWINDOW()->Width() / 2), true);
         else if (x >= scrollBarHPos + scrollBarWidth)
-          return (HorizontalScrollTo(xOffset + GetWINDOW()->right / 2), true);
+          return (ScrollColumns(GetWINDOW()->Width() / 2), true);
         else
           draggingHScrollBar = true, dragOffset = x - scrollBarHPos;
       } else {
@@ -609,14 +2042,75 @@ public:
         ButtonDownWithModifiers(Point(x, y), time, ModifierFlags(shift, ctrl, alt));
         return true;
       }
+    } else if ((button == 4 || button == 5) && shift) {
+      // Scroll the view horizontally.
+      return (AccelerateHorizontalScroll(button == 4 ? -1 : 1, time), true);
     } else if (button == 4 || button == 5) {
       // Scroll the view.
       int lines = std::max(GetWINDOW()->bottom / 4, 1);
       if (button == 4) lines *= -1;
-      return (ScrollTo(topLine + lines), true);
+      if (!ticking) return (ScrollTo(topLine + lines), true);
+      // Accumulate wheel events and apply them at frame rate from Tick().
+      if (pendingScroll * lines < 0) pendingScroll = 0; // reversed direction
+      pendingScroll += lines;
+      return true;
     }
     return false;
   }
+  /**
+   * Handles mouse motion without a button pressed.
+   * Scintilla restarts its dwell ticker whenever the mouse moves to another cell, so
+   * `SCN_DWELLSTART` is only sent once the mouse rests, and `SCN_DWELLEND` when it moves on.
+   * @param y The y coordinate of the mouse relative to this window.
+   * @param x The x coordinate of the mouse relative to this window.
+   * @param inside Whether or not the mouse is inside this window.
+   * @return whether or not Scintilla handled the mouse event
+   */
+  bool ScintillaTermbox::MouseHover(int y, int x, bool inside) {
+    if (!inside) {
+      if (mouseInside) MouseLeave(); // ends any dwell
+      mouseInside = false;
+      return false;
+    }
+    mouseInside = true;
+    MouseMove(y, x, false, false, false);
+    return true;
+  }
+  /**
+   * Returns the cells covered by the rectangular selection relative to this window, including
+   * the caret column and rows that are scrolled out of view.
+   */
+  PRectangle ScintillaTermbox::RectangularSelectionCells() {
+    const Point anchor = LocationFromPosition(sel.Rectangular().anchor);
+    const Point caret = LocationFromPosition(sel.Rectangular().caret);
+    return PRectangle(std::min(anchor.x, caret.x), std::min(anchor.y, caret.y),
+      std::max(anchor.x, caret.x) + 1, std::max(anchor.y, caret.y) + vs.lineHeight);
+  }
+  /**
+   * Invalidates the cells whose selection state differs between the given rectangular
+   * selections.
+   * @param before The cells covered by the previous selection.
+   * @param after The cells covered by the current selection.
+   * @see RectangularSelectionCells
+   */
+  void ScintillaTermbox::InvalidateSelectionChange(PRectangle before, PRectangle after) {
+    TermboxWin *w = GetWINDOW();
+    // Rows that only one of the selections covers.
+    const XYPOSITION left = std::min(before.left, after.left);
+    const XYPOSITION right = std::max(before.right, after.right);
+    w->Invalidate(
+      PRectangle(left, std::min(before.top, after.top), right, std::max(before.top, after.top)));
+    w->Invalidate(PRectangle(
+      left, std::min(before.bottom, after.bottom), right, std::max(before.bottom, after.bottom)));
+    // Columns that only one of the selections covers within the rows both cover. The edge
+    // columns are always included since the carets are drawn there.
+    const XYPOSITION top = std::max(before.top, after.top);
+    const XYPOSITION bottom = std::min(before.bottom, after.bottom);
+    w->Invalidate(PRectangle(
+      std::min(before.left, after.left), top, std::max(before.left, after.left) + 1, bottom));
+    w->Invalidate(PRectangle(
+      std::min(before.right, after.right) - 1, top, std::max(before.right, after.right), bottom));
+  }
   /**
    * Sends a mouse move event to Scintilla, returning whether or not Scintilla handled the
    * mouse event.
@@ -629,15 +2123,34 @@ public:
    */
   bool ScintillaTermbox::MouseMove(int y, int x, bool shift, bool ctrl, bool alt) {
     if (!draggingVScrollBar && !draggingHScrollBar) {
+      // Scintilla invalidates every line of a rectangular selection when dragging it out.
+      // As long as the view does not scroll, only repaint the cells that changed instead.
+      TermboxWin *w = GetWINDOW();
+      const bool diff = HaveMouseCapture() && sel.IsRectangular() && !Wrapping() &&
+        w->damage.empty();
+      const PRectangle before = diff ? RectangularSelectionCells() : PRectangle();
+      const Point caret = diff ? LocationFromPosition(sel.Rectangular().caret) : Point();
+      const Sci::Line topBefore = topLine;
+      const int xBefore = xOffset;
       ButtonMoveWithModifiers(Point(x, y), 0, ModifierFlags(shift, ctrl, alt));
+      if (diff && sel.IsRectangular() && topLine == topBefore && xOffset == xBefore) {
+        w->damage.clear();
+        InvalidateSelectionChange(before, RectangularSelectionCells());
+        const Point caretAfter = LocationFromPosition(sel.Rectangular().caret);
+        if (caretAfter.y != caret.y) { // repaint the old and new caret lines' backgrounds
+          w->Invalidate(PRectangle(0, caret.y, width, caret.y + vs.lineHeight));
+          w->Invalidate(PRectangle(0, caretAfter.y, width, caretAfter.y + vs.lineHeight));
+        }
+      }
     } else if (draggingVScrollBar) {
       int maxy = GetWINDOW()->bottom - scrollBarHeight, pos = y - dragOffset;
-      if (pos >= 0 && pos <= maxy) ScrollTo(pos * MaxScrollPos() / maxy);
+      if (pos >= 0 && pos <= maxy)
+        ScrollTo(pos * (MaxScrollPos() + UnwrappedLinesEstimate()) / maxy);
       return true;
     } else if (draggingHScrollBar) {
       int maxx = GetWINDOW()->right - scrollBarWidth, pos = x - dragOffset;
       if (pos >= 0 && pos <= maxx)
-        HorizontalScrollTo(pos * (scrollWidth - maxx - scrollBarWidth) / maxx);
+        ScrollColumns(pos * (scrollWidth - maxx - scrollBarWidth) / maxx - xOffset);
       return true;
     }
     return HaveMouseCapture();
@@ -676,21 +2189,491 @@ public:
    * Resize Scintilla Window.
    */
   void ScintillaTermbox::Resize(int width, int height) {
-    reinterpret_cast<TermboxWin *>(wMain.GetID())->right =
-    reinterpret_cast<TermboxWin *>(wMain.GetID())->left + width - 1;
-    reinterpret_cast<TermboxWin *>(wMain.GetID())->bottom =
-    reinterpret_cast<TermboxWin *>(wMain.GetID())->top + height - 1;
-    tb_clear();
-    Refresh();
+    TermboxWin *w = GetWINDOW();
+    SetBounds(w->left, w->top, w->left + width - 1, w->top + height - 1);
   }
   /**
    * Move Scintilla Window.
    */
   void ScintillaTermbox::Move(int new_x, int new_y) {
-    reinterpret_cast<TermboxWin *>(wMain.GetID())->Move(new_x, new_y);
-    tb_clear();
+    TermboxWin *w = GetWINDOW();
+    SetBounds(new_x, new_y, new_x + w->Width() - 1, new_y + w->Height() - 1);
+  }
+  /**
+   * Moves and/or resizes the Scintilla window to the given absolute screen bounds.
+   * Unlike `tb_clear()`, only the window's new area is repainted, so other parts of the screen
+   * are not rewritten. Cells the window no longer covers may already belong to another window,
+   * so they are left for the application to redraw. Line wrapping is only redone if the width
+   * changed.
+   */
+  void ScintillaTermbox::SetBounds(int left, int top, int right, int bottom) {
+    TermboxWin *w = GetWINDOW();
+    if (left == w->left && top == w->top && right == w->right && bottom == w->bottom) return;
+    w->left = left, w->top = top, w->right = right, w->bottom = bottom;
+    Invalidate();
     Refresh();
   }
+  /**
+   * Returns the number of milliseconds until there is background work to do, `0` if there is
+   * work to do now, or `-1` if there is none.
+   */
+  int ScintillaTermbox::Timeout() {
+    if (idler.state || trimPending) return 0;
+    const unsigned int now = Now();
+    int timeout = pendingScroll != 0 ? UntilNextFrame(lastScrollFrame, now) : -1;
+    if (!followText.empty()) {
+      const int followTimeout = UntilNextFrame(lastFollowFlush, now);
+      timeout = timeout < 0 ? followTimeout : std::min(timeout, followTimeout);
+    }
+    for (const auto &[reason, ticker] : fineTickers) {
+      const int tickerTimeout = std::max(static_cast<int>(ticker.deadline - now), 0);
+      timeout = timeout < 0 ? tickerTimeout : std::min(timeout, tickerTimeout);
+    }
+    return timeout;
+  }
+  /**
+   * Performs a slice of background work like wheel scrolling, inserting followed text, caret
+   * blinking and other tickers, idle styling, and wrapping.
+   * @return whether or not the window needs to be refreshed
+   */
+  bool ScintillaTermbox::Tick() {
+    ticking = true;
+    const unsigned int now = Now();
+    bool refresh = ScrollFrame(now);
+    std::vector<TickReason> due; // tickers may start or cancel tickers when fired
+    for (auto &[reason, ticker] : fineTickers)
+      if (static_cast<int>(ticker.deadline - now) <= 0)
+        due.push_back(reason), ticker.deadline = now + ticker.interval;
+    for (TickReason reason : due) {
+      if (reason == TickReason::caret) {
+        // Flip the caret cells instead of repainting lines. There may be none to flip if the
+        // terminal cursor is the only caret. While a popup is visible, the next refresh
+        // repaints everything under it instead.
+        caret.on = !caret.on;
+        if (popupVisible) {
+          refresh = true;
+          continue;
+        }
+        const bool drawn = !caretCells.empty();
+        ShowCarets();
+        refresh = refresh || drawn || !caretCells.empty();
+      } else
+        refresh = (TickFor(reason), true);
+    }
+    if (!followText.empty() && UntilNextFrame(lastFollowFlush, now) == 0)
+      refresh = (FlushFollow(), true);
+    if (trimPending) refresh = (TrimLines(), true);
+    if (!idler.state) return refresh;
+    idler.state = Idle();
+    UpdateCheckpoints();
+    return true;
+  }
+  /**
+   * Sets the number of lines between lexer checkpoints, or `0` to disable them.
+   */
+  void ScintillaTermbox::SetCheckpointInterval(int interval) {
+    checkpointInterval = std::max(interval, 0);
+    checkpoints.clear();
+    checkpointsExactTo = 0;
+    speculativeEnd = 0;
+    UpdateCheckpoints();
+  }
+  /**
+   * Sets whether or not the terminal cursor takes the shape of the main caret.
+   */
+  void ScintillaTermbox::SetCursorShapes(bool on) {
+    cursorShapes = on;
+    Redraw(); // the main caret may need to be drawn in its cell
+  }
+  /**
+   * Sets whether or not refreshes only repaint the parts of the window that changed.
+   */
+  void ScintillaTermbox::SetPartialRefresh(bool on) {
+    partialRefresh = on;
+    Invalidate();
+  }
+  /**
+   * Sets whether or not wheel scrolling is eased over several frames.
+   */
+  void ScintillaTermbox::SetScrollEasing(bool easing) { scrollEasing = easing; }
+  /**
+   * Sets the length in bytes from which a line is considered long, or `0` to disable long line
+   * mode.
+   */
+  void ScintillaTermbox::SetLongLineLength(Sci::Position length) {
+    longLineLength = std::max<Sci::Position>(length, 0);
+    UpdateLongLineMode();
+  }
+  /**
+   * Queues the given text to be appended to the document, following it if the view is at the
+   * end of the document.
+   * Text is inserted at most once per frame from `Tick()`, or on the next refresh, so a stream
+   * of small appends costs one modification and one repaint per frame.
+   */
+  void ScintillaTermbox::AppendFollow(const char *text, size_t len) {
+    if (ansiStyling) return AppendAnsi(std::string_view(text, len));
+    followText.append(text, len);
+  }
+  /**
+   * Queues the given text with its ANSI escape sequences stripped, recording the style selected
+   * by SGR sequences for each byte.
+   * An escape sequence split across appends is completed by the next append.
+   */
+  void ScintillaTermbox::AppendAnsi(std::string_view text) {
+    std::string joined;
+    if (!ansiPending.empty()) {
+      joined.swap(ansiPending);
+      text = joined.append(text);
+    }
+    for (size_t i = 0; i < text.length();) {
+      // memchr() is vectorized by the C library, so runs of plain text are scanned quickly.
+      const void *esc = memchr(text.data() + i, '\x1b', text.length() - i);
+      const size_t end = esc ? static_cast<const char *>(esc) - text.data() : text.length();
+      followText.append(text.data() + i, end - i);
+      followStyles.append(end - i, static_cast<char>(ansiStyle));
+      if (!esc) break;
+      i = EscapeSequenceEnd(text, end);
+      if (i == std::string_view::npos) {
+        ansiPending.assign(text.substr(end));
+        break;
+      }
+      if (text[end + 1] == '[' && text[i - 1] == 'm') {
+        ApplySGR(ansiAttributes, text.substr(end + 2, i - 1 - (end + 2)));
+        ansiStyle = AnsiStyle(ansiAttributes);
+      }
+    }
+  }
+  /**
+   * Returns the style for the given ANSI attributes, defining one if necessary.
+   * Styles above the predefined ones are allocated on demand. When they run out, the least
+   * recently used style is redefined, which also recolours any text still using it.
+   */
+  int ScintillaTermbox::AnsiStyle(const AnsiAttributes &attrs) {
+    const uint64_t key = attrs.Key();
+    if (key == AnsiAttributes{}.Key()) return 0;
+    ansiStyleClock++;
+    auto it = ansiStyles.find(key);
+    if (it != ansiStyles.end()) {
+      ansiStyleUse[it->second - ansiFirstStyle].second = ansiStyleClock;
+      return it->second;
+    }
+    int style = ansiFirstStyle + static_cast<int>(ansiStyleUse.size());
+    if (style > STYLE_MAX) {
+      auto lru = std::min_element(ansiStyleUse.begin(), ansiStyleUse.end(),
+        [](const auto &a, const auto &b) { return a.second < b.second; });
+      ansiStyles.erase(lru->first);
+      style = ansiFirstStyle + static_cast<int>(lru - ansiStyleUse.begin());
+      *lru = {key, ansiStyleClock};
+    } else
+      ansiStyleUse.emplace_back(key, ansiStyleClock);
+    ansiStyles[key] = style;
+    // Bypass WndProc(), which would flush the followed text being queued.
+    auto send = [this](Message msg, uptr_t wParam, sptr_t lParam) {
+      return ScintillaBase::WndProc(msg, wParam, lParam);
+    };
+    int fore = attrs.fore >= 0 ? attrs.fore : send(Message::StyleGetFore, STYLE_DEFAULT, 0);
+    int back = attrs.back >= 0 ? attrs.back : send(Message::StyleGetBack, STYLE_DEFAULT, 0);
+    if (attrs.reverse) std::swap(fore, back);
+    send(Message::StyleSetFore, style, fore);
+    send(Message::StyleSetBack, style, back);
+    send(Message::StyleSetBold, style, attrs.bold);
+    send(Message::StyleSetItalic, style, attrs.italic);
+    send(Message::StyleSetUnderline, style, attrs.underline);
+    return style;
+  }
+  /**
+   * Forgets the styles allocated for ANSI attributes after their definitions were reset, and
+   * redefines the style for the attributes currently in effect.
+   */
+  void ScintillaTermbox::ResetAnsiStyles() {
+    ansiStyles.clear(), ansiStyleUse.clear();
+    ansiStyle = AnsiStyle(ansiAttributes);
+  }
+  /**
+   * Enables or disables styling followed text from ANSI escape sequences.
+   * Text queued so far is inserted first, and any attributes in effect are reset.
+   */
+  void ScintillaTermbox::SetAnsiStyling(bool on) {
+    FlushFollow();
+    ansiStyling = on;
+    ansiPending.clear();
+    ansiAttributes = AnsiAttributes{}, ansiStyle = 0;
+  }
+  /**
+   * Writes the document's text, styles, fold levels and states, line states, markers, and the
+   * selections and scroll position to the given session file.
+   * All sections are padded to multiples of 8 bytes so the file can be used in place when
+   * memory-mapped.
+   */
+  bool ScintillaTermbox::SaveSession(const char *path) {
+    const Sci::Position length = pdoc->Length();
+    const Sci::Line lines = pdoc->LinesTotal();
+    const SessionHeader header{sessionMagic, static_cast<uint64_t>(length),
+      static_cast<uint64_t>(lines), sel.Count(), sel.Main(), topLine, xOffset};
+    std::vector<unsigned char> styles(length), folds(lines);
+    pdoc->GetStyleRange(styles.data(), 0, length);
+    std::vector<int32_t> levels(lines), states(lines), markers(lines);
+    for (Sci::Line line = 0; line < lines; line++) {
+      levels[line] = static_cast<int32_t>(pdoc->GetFoldLevel(line));
+      states[line] = pdoc->GetLineState(line);
+      markers[line] = pdoc->GetMark(line);
+      folds[line] = (pcs->GetExpanded(line) ? foldExpanded : 0) |
+        (pcs->GetVisible(line) ? foldVisible : 0);
+    }
+    std::vector<int64_t> selections;
+    for (size_t r = 0; r < sel.Count(); r++)
+      selections.insert(selections.end(), {sel.Range(r).caret.Position(),
+        sel.Range(r).caret.VirtualSpace(), sel.Range(r).anchor.Position(),
+        sel.Range(r).anchor.VirtualSpace()});
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = WriteBytes(f, &header, sizeof(header)) &&
+      WriteBytes(f, pdoc->BufferPointer(), length) && WriteBytes(f, styles.data(), length) &&
+      WriteBytes(f, levels.data(), lines * sizeof(int32_t)) &&
+      WriteBytes(f, states.data(), lines * sizeof(int32_t)) &&
+      WriteBytes(f, markers.data(), lines * sizeof(int32_t)) &&
+      WriteBytes(f, folds.data(), lines) &&
+      WriteBytes(f, selections.data(), selections.size() * sizeof(int64_t));
+    return fclose(f) == 0 && ok;
+  }
+  /**
+   * Replaces the document and view state with the contents of the given session file.
+   * The file is memory-mapped and each section is applied in bulk straight from the mapping.
+   * Undo history is cleared and the document is marked as saved.
+   * @return whether or not the session was restored
+   */
+  bool ScintillaTermbox::LoadSession(const char *path) {
+    const MappedFile file(path);
+    std::string_view bytes = file.View(), text, styles, levels, states, markers, folds, ranges;
+    SessionHeader header;
+    // Bound the counts by the file size before multiplying them, then check the whole file
+    // before changing anything.
+    const uint64_t size = bytes.length();
+    if (!ReadValue(bytes, header) || header.magic != sessionMagic || header.length > size ||
+      header.lines > size || header.selections > size / (4 * sizeof(int64_t)) ||
+      header.mainSelection >= header.selections || !ReadBytes(bytes, header.length, text) ||
+      !ReadBytes(bytes, header.length, styles) ||
+      !ReadBytes(bytes, header.lines * sizeof(int32_t), levels) ||
+      !ReadBytes(bytes, header.lines * sizeof(int32_t), states) ||
+      !ReadBytes(bytes, header.lines * sizeof(int32_t), markers) ||
+      !ReadBytes(bytes, header.lines, folds) ||
+      !ReadBytes(bytes, header.selections * 4 * sizeof(int64_t), ranges))
+      return false;
+    const bool unicodeLineEnds = static_cast<int>(pdoc->GetLineEndTypesActive()) &
+      static_cast<int>(LineEndType::Unicode);
+    if (CountLines(text, unicodeLineEnds) != header.lines) return false;
+    std::vector<SelectionRange> selRanges;
+    for (size_t r = 0; r < header.selections; r++) {
+      int64_t range[4];
+      memcpy(range, ranges.data() + r * sizeof(range), sizeof(range));
+      for (int i = 0; i < 4; i += 2)
+        if (range[i] < 0 || static_cast<uint64_t>(range[i]) > header.length ||
+          range[i + 1] < 0 || range[i + 1] > INT_MAX)
+          return false;
+      selRanges.emplace_back(SelectionPosition(range[0], range[1]),
+        SelectionPosition(range[2], range[3]));
+    }
+    const bool readOnly = pdoc->IsReadOnly(), collectingUndo = pdoc->IsCollectingUndo();
+    pdoc->SetReadOnly(false);
+    pdoc->SetUndoCollection(false);
+    pdoc->DeleteChars(0, pdoc->Length());
+    pdoc->InsertString(0, text.data(), text.length());
+    pdoc->SetUndoCollection(collectingUndo);
+    DeleteUndoHistory();
+    pdoc->SetSavePoint();
+    pdoc->SetReadOnly(readOnly);
+    const Sci::Line lines = pdoc->LinesTotal();
+    pdoc->StartStyling(0);
+    pdoc->SetStyles(styles.length(), styles.data());
+    WndProc(Message::MarkerDeleteAll, static_cast<uptr_t>(-1), 0);
+    for (Sci::Line line = 0; line < lines; line++) {
+      int32_t level, state, mask;
+      memcpy(&level, levels.data() + line * sizeof(int32_t), sizeof(int32_t));
+      memcpy(&state, states.data() + line * sizeof(int32_t), sizeof(int32_t));
+      memcpy(&mask, markers.data() + line * sizeof(int32_t), sizeof(int32_t));
+      pdoc->SetLevel(line, static_cast<FoldLevel>(level));
+      pdoc->SetLineState(line, state);
+      if (mask) WndProc(Message::MarkerAddSet, line, mask);
+      pcs->SetExpanded(line, folds[line] & foldExpanded);
+      pcs->SetVisible(line, line, folds[line] & foldVisible);
+    }
+    for (size_t r = 0; r < selRanges.size(); r++) {
+      SelectionRange &selRange = selRanges[r];
+      // Positions may be inside characters if the file was not written for this text.
+      selRange.caret.SetPosition(pdoc->MovePositionOutsideChar(selRange.caret.Position(), 1));
+      selRange.anchor.SetPosition(pdoc->MovePositionOutsideChar(selRange.anchor.Position(), 1));
+      r == 0 ? sel.SetSelection(selRange) : sel.AddSelection(selRange);
+    }
+    sel.SetMain(header.mainSelection);
+    checkpointsExactTo = 0;
+    UpdateCheckpoints();
+    SetScrollBars();
+    ScrollTo(header.topLine);
+    HorizontalScrollTo(header.xOffset);
+    Invalidate();
+    return true;
+  }
+  /** Returns a hash identifying the current lexer and the given version of its configuration. */
+  uint64_t ScintillaTermbox::LexerHash(int version) {
+    std::string name(WndProc(Message::GetLexerLanguage, 0, 0), '\0');
+    WndProc(Message::GetLexerLanguage, 0, reinterpret_cast<sptr_t>(name.data()));
+    return Hash(std::string_view(reinterpret_cast<const char *>(&version), sizeof(version)),
+      Hash(name));
+  }
+  /**
+   * Styles the whole document and writes its styles, fold levels, and line states to the given
+   * file, keyed by a hash of the document's text and the lexer.
+   * All sections are padded to multiples of 8 bytes so the file can be used in place when
+   * memory-mapped.
+   */
+  bool ScintillaTermbox::SaveStyleCache(const char *path, int version) {
+    pdoc->EnsureStyledTo(pdoc->Length());
+    const Sci::Position length = pdoc->Length();
+    const Sci::Line lines = pdoc->LinesTotal();
+    const StyleCacheHeader header{styleCacheMagic,
+      Hash(std::string_view(pdoc->BufferPointer(), length)), LexerHash(version),
+      static_cast<uint64_t>(length), static_cast<uint64_t>(lines)};
+    std::vector<unsigned char> styles(length);
+    pdoc->GetStyleRange(styles.data(), 0, length);
+    std::vector<int32_t> levels(lines), states(lines);
+    for (Sci::Line line = 0; line < lines; line++)
+      levels[line] = static_cast<int32_t>(pdoc->GetFoldLevel(line)),
+      states[line] = pdoc->GetLineState(line);
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = WriteBytes(f, &header, sizeof(header)) && WriteBytes(f, styles.data(), length) &&
+      WriteBytes(f, levels.data(), lines * sizeof(int32_t)) &&
+      WriteBytes(f, states.data(), lines * sizeof(int32_t));
+    return fclose(f) == 0 && ok;
+  }
+  /**
+   * Applies the styles, fold levels, and line states in the given style cache file to the
+   * document instead of lexing it, if the cache matches the document's text and lexer.
+   * @return whether or not the cache was applied
+   */
+  bool ScintillaTermbox::LoadStyleCache(const char *path, int version) {
+    const MappedFile file(path);
+    std::string_view bytes = file.View(), styles, levels, states;
+    StyleCacheHeader header;
+    const Sci::Position length = pdoc->Length();
+    const Sci::Line lines = pdoc->LinesTotal();
+    if (!ReadValue(bytes, header) || header.magic != styleCacheMagic ||
+      header.length != static_cast<uint64_t>(length) ||
+      header.lines != static_cast<uint64_t>(lines) || header.lexerHash != LexerHash(version) ||
+      !ReadBytes(bytes, length, styles) || !ReadBytes(bytes, lines * sizeof(int32_t), levels) ||
+      !ReadBytes(bytes, lines * sizeof(int32_t), states) ||
+      header.contentHash != Hash(std::string_view(pdoc->BufferPointer(), length)))
+      return false;
+    pdoc->StartStyling(0);
+    pdoc->SetStyles(length, styles.data());
+    for (Sci::Line line = 0; line < lines; line++) {
+      int32_t level, state;
+      memcpy(&level, levels.data() + line * sizeof(int32_t), sizeof(int32_t));
+      memcpy(&state, states.data() + line * sizeof(int32_t), sizeof(int32_t));
+      pdoc->SetLineState(line, state);
+      if (static_cast<int32_t>(pdoc->GetFoldLevel(line)) != level)
+        pdoc->SetLevel(line, static_cast<FoldLevel>(level));
+    }
+    checkpointsExactTo = 0;
+    UpdateCheckpoints();
+    return true;
+  }
+  /**
+   * Inserts queued followed text at the end of the document, even if the document is read-only,
+   * and scrolls to the end if the view was already there.
+   */
+  void ScintillaTermbox::FlushFollow() {
+    lastFollowFlush = Now();
+    if (followText.empty()) return;
+    const bool atEnd = topLine >= MaxScrollPos();
+    const bool readOnly = pdoc->IsReadOnly();
+    const Sci::Position pos = pdoc->Length();
+    // Take the queue first, since messages sent from modification notifications flush it too.
+    std::string text, styles;
+    text.swap(followText), styles.swap(followStyles);
+    pdoc->SetReadOnly(false);
+    const Sci::Position inserted = pdoc->InsertString(pos, text.data(), text.length());
+    pdoc->SetReadOnly(readOnly);
+    if (inserted == 0) {
+      // The document is still being modified, as when a message is sent from a modification
+      // notification, so put the text back in front of anything queued since and retry later.
+      text += followText, styles += followStyles;
+      followText.swap(text), followStyles.swap(styles);
+      return;
+    }
+    if (styles.length() == text.length() &&
+      inserted == static_cast<Sci::Position>(text.length())) {
+      pdoc->StartStyling(pos);
+      pdoc->SetStyles(styles.length(), styles.data());
+    }
+    // Keep the queue's capacity for the next batch.
+    text.clear(), styles.clear();
+    if (followText.empty()) followText.swap(text), followStyles.swap(styles);
+    TrimLines();
+    if (atEnd) ScrollTo(MaxScrollPos());
+  }
+  /**
+   * Deletes lines from the start of the document in one modification so that `maxLines`
+   * remain, once the document has grown by a quarter more than that.
+   * Trimming in chunks keeps the cost of deleting lines, and of shifting the per-line styles,
+   * markers, and fold levels after them, amortized over many appended lines.
+   * The deletion is not recorded and the undo history, whose positions would all be stale, is
+   * discarded, so memory stays bounded. If the host chose to record trims and undo is being
+   * collected, the deletion is recorded as an undo action instead.
+   */
+  void ScintillaTermbox::TrimLines() {
+    trimPending = false;
+    if (maxLines <= 0 || pdoc->LinesTotal() <= maxLines + maxLines / 4) return;
+    const bool readOnly = pdoc->IsReadOnly(), collectingUndo = pdoc->IsCollectingUndo();
+    const bool recordUndo = collectingUndo && trimRecordsUndo;
+    pdoc->SetReadOnly(false);
+    pdoc->SetUndoCollection(recordUndo);
+    pdoc->DeleteChars(0, pdoc->LineStart(pdoc->LinesTotal() - maxLines));
+    pdoc->SetUndoCollection(collectingUndo);
+    if (!recordUndo) DeleteUndoHistory();
+    pdoc->SetReadOnly(readOnly);
+  }
+  /**
+   * Sets the number of lines the document is trimmed to as text is inserted, or `0` for no
+   * limit, and whether trimming records the deletion in undo history instead of discarding it.
+   */
+  void ScintillaTermbox::SetMaxLines(Sci::Line lines, bool recordUndo) {
+    trimRecordsUndo = recordUndo;
+    maxLines = std::max<Sci::Line>(lines, 0);
+    TrimLines();
+  }
+  /**
+   * Enables or disables pager mode for viewing large documents that are never edited.
+   * Pager mode makes the document read-only, stops collecting undo and change history, only
+   * lexes up to the end of the view, in the background so that jumping deep into the document
+   * does not block and lexer checkpoints still apply, and keeps the layouts of all visible
+   * lines. Disabling pager mode restores the previous settings, but not the discarded
+   * undo history.
+   */
+  void ScintillaTermbox::SetPagerMode(bool on) {
+    if (on == pagerSettings.has_value()) return;
+    if (on) {
+      pagerSettings = PagerSettings{WndProc(Message::GetReadOnly, 0, 0) != 0,
+        WndProc(Message::GetUndoCollection, 0, 0) != 0,
+        static_cast<int>(WndProc(Message::GetChangeHistory, 0, 0)),
+        static_cast<int>(WndProc(Message::GetIdleStyling, 0, 0)),
+        static_cast<int>(WndProc(Message::GetLayoutCache, 0, 0))};
+      WndProc(Message::SetReadOnly, 1, 0);
+      WndProc(Message::SetUndoCollection, 0, 0);
+      WndProc(Message::EmptyUndoBuffer, 0, 0);
+      WndProc(Message::SetChangeHistory, static_cast<uptr_t>(ChangeHistoryOption::Disabled), 0);
+      WndProc(Message::SetIdleStyling, static_cast<uptr_t>(IdleStyling::ToVisible), 0);
+      WndProc(Message::SetLayoutCache, static_cast<uptr_t>(LineCache::Page), 0);
+    } else {
+      const PagerSettings &saved = *pagerSettings;
+      WndProc(Message::SetReadOnly, saved.readOnly, 0);
+      WndProc(Message::SetUndoCollection, saved.undoCollection, 0);
+      WndProc(Message::SetChangeHistory, saved.changeHistory, 0);
+      WndProc(Message::SetIdleStyling, saved.idleStyling, 0);
+      WndProc(Message::SetLayoutCache, saved.layoutCache, 0);
+      pagerSettings.reset();
+    }
+  }
 
   } // namespace Scintilla::Internal
 
@@ -701,6 +2684,10 @@ extern "C" {
   void *scintilla_new(void (*callback)(void *, int, SCNotification *, void *), void *userdata) {
     return reinterpret_cast<void *>(new ScintillaTermbox(callback, userdata));
   }
+  void *scintilla_new_lazy(
+    void (*callback)(void *, int, SCNotification *, void *), void *userdata) {
+    return reinterpret_cast<void *>(new ScintillaTermbox(callback, userdata, true));
+  }
   sptr_t scintilla_send_message(void *sci, unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
     return reinterpret_cast<ScintillaTermbox *>(sci)->WndProc(
       static_cast<Scintilla::Message>(iMessage), wParam, lParam);
@@ -715,8 +2702,9 @@ bool scintilla_send_mouse(void *sci, int event, int button, int y, int x,
   int begy = w->top, begx = w->left;
   int maxy = w->bottom, maxx = w->right;
   // Ignore most events outside the window.
-  if ((x < begx || x > begx + maxx || y < begy || y > begy + maxy) && button != 4 &&
-    button != 5 && event != SCM_DRAG)
+  const bool outside = x < begx || x > begx + maxx || y < begy || y > begy + maxy;
+  if (event == SCM_MOVE) return scitermbox->MouseHover(y - begy, x - begx, !outside);
+  if (outside && button != 4 && button != 5 && event != SCM_DRAG)
     return false;
   y = y - begy, x = x - begx;
   if (event == SCM_PRESS)
@@ -731,6 +2719,27 @@ char *scintilla_get_clipboard(void *sci, int *len) {
   return reinterpret_cast<ScintillaTermbox *>(sci)->GetClipboard(len);
 }
   void scintilla_refresh(void *sci) { reinterpret_cast<ScintillaTermbox *>(sci)->Refresh(); }
+  void scintilla_suspend(void *sci) { reinterpret_cast<ScintillaTermbox *>(sci)->Suspend(); }
+  void scintilla_resume(void *sci) { reinterpret_cast<ScintillaTermbox *>(sci)->Resume(); }
+  void scintilla_memory_usage(void *sci, struct sci_mem_stats *stats) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->MemoryUsage(stats);
+  }
+  int scintilla_replace_all(void *sci, const char *find, const char *replace, int flags,
+    int start, int end) {
+    return reinterpret_cast<ScintillaTermbox *>(sci)->ReplaceAll(
+      find, replace, static_cast<Scintilla::FindOption>(flags), start, end);
+  }
+  void scintilla_set_compressed_undo(void *sci, int threshold, int memory) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetCompressedUndo(
+      std::max(threshold, 0), std::max(memory, 0));
+  }
+  void scintilla_set_cursor_shapes(void *sci, bool on) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetCursorShapes(on);
+  }
+  void scintilla_set_partial_refresh(void *sci, bool on) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetPartialRefresh(on);
+  }
+  void scintilla_invalidate(void *sci) { reinterpret_cast<ScintillaTermbox *>(sci)->Invalidate(); }
   void scintilla_delete(void *sci) { delete reinterpret_cast<ScintillaTermbox *>(sci); }
   void scintilla_resize(void *sci, int width, int height) {
     reinterpret_cast<ScintillaTermbox *>(sci)->Resize(width, height);
@@ -738,4 +2747,39 @@ char *scintilla_get_clipboard(void *sci, int *len) {
   void scintilla_move(void *sci, int new_x, int new_y) {
     reinterpret_cast<ScintillaTermbox *>(sci)->Move(new_x, new_y);
   }
+  int scintilla_timeout(void *sci) { return reinterpret_cast<ScintillaTermbox *>(sci)->Timeout(); }
+  bool scintilla_tick(void *sci) { return reinterpret_cast<ScintillaTermbox *>(sci)->Tick(); }
+  void scintilla_set_lexer_checkpoints(void *sci, int interval) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetCheckpointInterval(interval);
+  }
+  void scintilla_set_scroll_easing(void *sci, bool easing) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetScrollEasing(easing);
+  }
+  void scintilla_set_long_line_length(void *sci, int length) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetLongLineLength(length);
+  }
+  void scintilla_set_pager_mode(void *sci, bool on) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetPagerMode(on);
+  }
+  void scintilla_append_follow(void *sci, const char *data, int len) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->AppendFollow(data, len);
+  }
+  void scintilla_set_max_lines(void *sci, int lines, bool record_undo) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetMaxLines(lines, record_undo);
+  }
+  void scintilla_set_ansi_styling(void *sci, bool on) {
+    reinterpret_cast<ScintillaTermbox *>(sci)->SetAnsiStyling(on);
+  }
+  bool scintilla_save_style_cache(void *sci, const char *path, int version) {
+    return reinterpret_cast<ScintillaTermbox *>(sci)->SaveStyleCache(path, version);
+  }
+  bool scintilla_load_style_cache(void *sci, const char *path, int version) {
+    return reinterpret_cast<ScintillaTermbox *>(sci)->LoadStyleCache(path, version);
+  }
+  bool scintilla_save_session(void *sci, const char *path) {
+    return reinterpret_cast<ScintillaTermbox *>(sci)->SaveSession(path);
+  }
+  bool scintilla_load_session(void *sci, const char *path) {
+    return reinterpret_cast<ScintillaTermbox *>(sci)->LoadSession(path);
+  }
 }
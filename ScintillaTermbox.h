@@ -1,6 +1,7 @@
 #ifndef SCINTILLATERMBOX_H
 #define SCINTILLATERMBOX_H
 
+#include <stddef.h>
 #include <termbox.h>
 
 #ifdef __cplusplus
@@ -15,6 +16,15 @@ extern "C" {
  */
 void *scintilla_new(
   void (*callback)(void *sci, int iMessage, SCNotification *n, void *userdata), void *userdata);
+/**
+ * Creates a new Scintilla window like `scintilla_new()`, but defers allocating its drawing
+ * surface and refreshing its styles until it is first refreshed.
+ * This makes creating many windows that may never be shown, like one per open buffer, cheap.
+ * @param callback A callback function for Scintilla notifications.
+ * @param userdata Userdata to pass to *callback*.
+ */
+void *scintilla_new_lazy(
+  void (*callback)(void *sci, int iMessage, SCNotification *n, void *userdata), void *userdata);
 /**
  * Sends the given message with parameters to the given Scintilla window.
  * Curses does not have to be initialized before calling this function.
@@ -44,7 +54,10 @@ void scintilla_send_key(void *sci, int key, bool shift, bool ctrl, bool alt);
  * Sends the specified mouse event to the given Scintilla window for processing.
  * Curses must have been initialized prior to calling this function.
  * @param sci The Scintilla window returned by `scintilla_new()`.
- * @param event The mouse event (`SCM_CLICK`, `SCM_DRAG`, or `SCM_RELEASE`).
+ * @param event The mouse event (`SCM_CLICK`, `SCM_DRAG`, `SCM_RELEASE`, or `SCM_MOVE`).
+ *   `SCM_MOVE` is motion without a button pressed, which drives `SCN_DWELLSTART` and
+ *   `SCN_DWELLEND` notifications once the application calls `scintilla_tick()`. Moving out of
+ *   the window ends any dwell.
  * @param button The button number pressed, or `0` if none.
  * @param y The absolute y coordinate of the mouse event.
  * @param x The absolute x coordinate of the mouse event.
@@ -68,12 +81,43 @@ bool scintilla_send_mouse(void *sci, int event, int button, int y, int x,
 char *scintilla_get_clipboard(void *sci, int *len);
 /**
  * Refreshes the Scintilla window on the physical screen.
+ * The whole window is repainted unless partial refreshes are enabled with
+ * `scintilla_set_partial_refresh()`.
  * This should be done along with the normal curses `refresh()`, as the physical screen is
  * updated when calling this function.
  * Curses must have been initialized prior to calling this function.
  * @param sci The Scintilla window returned by `scintilla_new()`.
  */
 void scintilla_refresh(void *sci);
+/**
+ * Sets whether or not `scintilla_refresh()` only repaints the parts of the Scintilla window that
+ * changed since the last refresh, which is off by default.
+ * Partial refreshes leave cells the application drew over the window, or cleared, as they are
+ * until `scintilla_invalidate()` is called.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param on Whether or not to only repaint what changed.
+ */
+void scintilla_set_partial_refresh(void *sci, bool on);
+/**
+ * Marks the whole Scintilla window for repainting on the next `scintilla_refresh()`.
+ * With partial refreshes enabled, call this after drawing over the window or clearing the
+ * screen.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+void scintilla_invalidate(void *sci);
+/**
+ * Suspends the given Scintilla window while it is not displayed, freeing its position and line
+ * layout caches, drawing surface, and any autocompletion or calltip popups.
+ * The document and its selections, folds, and scroll position are kept.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+void scintilla_suspend(void *sci);
+/**
+ * Resumes the given suspended Scintilla window so it is fully repainted on the next
+ * `scintilla_refresh()`, which also resumes it implicitly.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+void scintilla_resume(void *sci);
 /**
  * Deletes the given Scintilla window.
  * Curses must have been initialized prior to calling this function.
@@ -82,18 +126,225 @@ void scintilla_refresh(void *sci);
 void scintilla_delete(void *sci);
 /**
  * Resize Scintilla window.
+ * Cells the window no longer covers are left for the application to redraw.
  */
 void scintilla_resize(void *sci, int width, int height);
 /**
  * Move Scintilla window.
+ * Cells the window no longer covers are left for the application to redraw.
  */
 void scintilla_move(void *sci, int new_x, int new_y);
+/**
+ * Returns the number of milliseconds until the given Scintilla window has background work to
+ * do, `0` if it has work to do now, or `-1` if it has none.
+ * This is suitable as the timeout for `tb_peek_event()`, calling `scintilla_tick()` when it
+ * expires.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+int scintilla_timeout(void *sci);
+/**
+ * Performs a slice of the given Scintilla window's background work, like idle styling and
+ * wrapping.
+ * Until this function is first called, that work is performed synchronously while painting.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @return whether or not the window should be refreshed
+ */
+bool scintilla_tick(void *sci);
+/**
+ * Enables lexer state checkpoints every *interval* lines, or disables them if *interval* is `0`.
+ * When the view jumps far beyond the styled part of the document and idle styling is enabled,
+ * lexing of the visible lines starts from the nearest checkpoint instead of from the end of
+ * styling. Idle styling later corrects any lines styled from a stale checkpoint.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param interval The number of lines between checkpoints.
+ */
+void scintilla_set_lexer_checkpoints(void *sci, int interval);
+/**
+ * Sets whether or not mouse wheel scrolling is eased, which is the default.
+ * Once the application calls `scintilla_tick()`, wheel events are accumulated and applied at
+ * frame rate instead of scrolling the view for each event. With easing, the view scrolls half of
+ * the remaining distance per frame. Without it, each frame scrolls by everything accumulated
+ * since the previous frame.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param easing Whether or not to ease wheel scrolling.
+ */
+void scintilla_set_scroll_easing(void *sci, bool easing);
+/**
+ * Enables long line mode for lines of at least *length* bytes, or disables it if *length* is `0`.
+ * While a long line is visible, the layouts of all visible lines are kept between refreshes
+ * instead of only the caret line's, so minified files and single-line logs are not measured
+ * in full on every refresh. Only the visible columns of long lines are drawn. A long line is
+ * still laid out in full once each time it changes.
+ * The layout cache level set with `SCI_SETLAYOUTCACHE` is restored when no long line is visible.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param length The minimum length of a long line in bytes.
+ */
+void scintilla_set_long_line_length(void *sci, int length);
+/**
+ * Enables or disables pager mode for viewing large documents, like logs, that are never edited.
+ * Pager mode makes the document read-only, stops collecting undo and change history, only lexes
+ * up to the end of the view, in the background from `scintilla_tick()` so that lexer
+ * checkpoints still apply, and keeps the layouts of all visible lines between refreshes.
+ * Disabling pager mode restores the previous settings. Undo history discarded when pager mode
+ * was enabled is not restored.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param on Whether or not to enable pager mode.
+ */
+void scintilla_set_pager_mode(void *sci, bool on);
+/**
+ * Appends the given streamed text, like build output or `tail -f`, to the end of the document.
+ * Appends are batched and inserted once per frame from `scintilla_tick()`, or on the next
+ * `scintilla_refresh()`, even if the document is read-only. Queued text is also inserted before
+ * any message, key, or mouse press is handled, so they always see it, except while the document
+ * is being modified, as in an `SCN_MODIFIED` handler. If the view is at the end of the
+ * document, it follows the new text.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param data The text to append.
+ * @param len The length of *data*.
+ */
+void scintilla_append_follow(void *sci, const char *data, int len);
+/**
+ * Sets the number of lines the document keeps as text is inserted, like a ring buffer for log
+ * and REPL panes, or `0` for no limit, which is the default.
+ * Once the document grows a quarter beyond *lines*, the excess lines are deleted from the start
+ * of the document in one chunk on the next `scintilla_tick()` or `scintilla_refresh()`.
+ * By default, the deletion is not recorded and undo history, which it would invalidate, is
+ * discarded, so memory use stays bounded. Alternatively, the deletion is recorded as an undo
+ * action so that the undo history stays valid, at the cost of keeping the deleted text in it.
+ * Undoing it then restores the deleted lines. Undo history is always discarded if undo is not
+ * being collected.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param lines The maximum number of lines.
+ * @param record_undo Whether or not to record deleted lines in undo history instead of
+ *   discarding it.
+ */
+void scintilla_set_max_lines(void *sci, int lines, bool record_undo);
+/**
+ * Enables or disables styling text appended with `scintilla_append_follow()` from the ANSI
+ * escape sequences in it, like the colours in build and test output.
+ * Escape sequences are stripped from the text, even if split across appends. SGR colours and
+ * attributes are mapped to styles above `STYLE_LASTPREDEFINED` that are defined as needed, with
+ * the least recently used style being redefined when they run out. Text without attributes uses
+ * style `0`. The document should have no lexer.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param on Whether or not to enable ANSI styling.
+ */
+void scintilla_set_ansi_styling(void *sci, bool on);
+/**
+ * Styles the whole document and saves its styles, fold levels, and lexer line states to the
+ * given style cache file, so that reopening the same text can skip lexing with
+ * `scintilla_load_style_cache()`.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param path The path of the style cache file to write.
+ * @param version The version of the lexer and its configuration, like keywords and properties.
+ *   Caches saved with a different version are not loaded.
+ * @return whether or not the cache was saved
+ */
+bool scintilla_save_style_cache(void *sci, const char *path, int version);
+/**
+ * Applies the styles, fold levels, and lexer line states in the given style cache file instead
+ * of lexing the document, if the file was saved for the same text, lexer, and *version*.
+ * The file is memory-mapped and its styles are applied in place. Call this after setting the
+ * document's text and lexer.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param path The path of the style cache file to read.
+ * @param version The version passed to `scintilla_save_style_cache()`.
+ * @return whether or not the cache matched and was applied
+ */
+bool scintilla_load_style_cache(void *sci, const char *path, int version);
+/**
+ * Saves the given Scintilla window's state to the given session file: the document's text,
+ * styles, fold levels and fold states, lexer line states, markers, selections, and scroll
+ * position.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param path The path of the session file to write.
+ * @return whether or not the session was saved
+ */
+bool scintilla_save_session(void *sci, const char *path);
+/**
+ * Restores the given Scintilla window's state from the given session file saved by
+ * `scintilla_save_session()`, replacing the document's text.
+ * The file is memory-mapped and applied in bulk without lexing, so many buffers can be restored
+ * quickly at startup. Set the lexer and styles before calling this. Undo history is cleared and
+ * the document is marked as saved.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param path The path of the session file to read.
+ * @return whether or not the session was restored
+ */
+bool scintilla_load_session(void *sci, const char *path);
+/** Estimated memory used by a Scintilla window, in bytes. */
+struct sci_mem_stats {
+  size_t text; // document text
+  size_t styles; // style bytes of the document text
+  size_t undo; // undo history text
+  size_t line_index; // line start positions and per-line data like fold levels and line states
+  size_t markers; // markers and indicators
+  size_t caches; // line layout and position caches
+  size_t platform; // clipboard, popup lists, queued appends, lexer checkpoints, and windows
+};
+/**
+ * Fills *stats* with an estimate of the memory used by the given Scintilla window.
+ * A document shared by several windows is counted by each of them.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param stats The structure to fill.
+ */
+void scintilla_memory_usage(void *sci, struct sci_mem_stats *stats);
+/**
+ * Enables compressed undo for edits of at least *threshold* removed and inserted bytes, or
+ * disables it if *threshold* is `0`, which is the default.
+ * The text of such edits made with `SCI_REPLACETARGET`, `SCI_REPLACESEL`, `SCI_DELETERANGE`,
+ * `SCI_CLEARALL`, and `SCI_SETTEXT` outside of undo groups is compressed instead of being kept
+ * in undo history. Once more than *memory* bytes of compressed text accumulate, the oldest is
+ * moved to a temporary file.
+ * Compressed edits are recorded as container undo actions whose tokens are addresses, so they
+ * do not collide with the small integer or pointer tokens hosts pass to `SCI_ADDUNDOACTION`.
+ * Like undo history, they belong to the document, so they can be undone from any view of it.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param threshold The minimum size of a compressed edit in bytes.
+ * @param memory The number of bytes of compressed text to keep in memory.
+ */
+void scintilla_set_compressed_undo(void *sci, int threshold, int memory);
+/**
+ * Replaces all matches of the given text or regular expression between *start* and *end*.
+ * Unlike replacing each match with `SCI_REPLACETARGET`, the result is built in one buffer and
+ * applied as a single edit with one undo action, so modification notifications are not sent
+ * per match. The target set with `SCI_SETTARGETRANGE` is left unchanged.
+ * Because the text from the first match to the last is replaced as a whole:
+ * - Markers, fold levels and expansion, and line states of the lines in between are restored
+ *   if the replacements keep the number of lines, though with new marker handles. Otherwise,
+ *   they are merged into the first line or dropped as for any deletion of those lines.
+ * - Indicators and annotations in between are cleared, and the text in between is restyled.
+ * - Unless compressed undo applies, undo history holds copies of the text before and after.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param find The text or regular expression to find.
+ * @param replace The replacement text. For regular expressions, `\1` through `\9` are
+ *   replaced with tagged expressions as in `SCI_REPLACETARGETRE`.
+ * @param flags The `SCFIND_*` search flags.
+ * @param start The start of the range to search.
+ * @param end The end of the range to search, or `-1` for the end of the document.
+ * @return the number of replacements
+ */
+int scintilla_replace_all(void *sci, const char *find, const char *replace, int flags,
+  int start, int end);
+/**
+ * Sets whether or not the terminal cursor takes the shape of the main caret, which is the
+ * default.
+ * Line carets use a bar cursor, block carets a block cursor, and overtype mode an underline
+ * or block cursor, blinking if the caret blinks. The main caret is then drawn by the terminal
+ * instead of into the text. The default `CARETSTYLE_CURSES` style leaves the cursor shape
+ * alone. Only the focused window shapes the cursor, and the sequence is written to the
+ * controlling terminal.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param on Whether or not to shape the terminal cursor.
+ */
+void scintilla_set_cursor_shapes(void *sci, bool on);
 
 #define IMAGE_MAX 31
 
 #define SCM_PRESS 1
 #define SCM_DRAG 2
 #define SCM_RELEASE 3
+#define SCM_MOVE 4
 
 #ifdef __cplusplus
 }
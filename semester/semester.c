@@ -10,6 +10,13 @@
 #include "ScintillaTermbox.h"
 
 #define SSM(m, w, l) scintilla_send_message(sci, m, w, l)
+#define RESIZE_DELAY 50 // milliseconds to wait for the terminal to stop resizing
+
+static int millis(void) {
+  struct timeval time = {0, 0};
+  gettimeofday(&time, NULL);
+  return time.tv_sec * 1000 + time.tv_usec / 1000;
+}
 
 typedef void Scintilla;
 
@@ -26,6 +33,7 @@ int main(int argc, char **argv) {
   }
   tb_select_input_mode(1 | 4);
   tb_select_output_mode(5);
+  printf("\x1b[?1003h"), fflush(stdout); // report mouse motion without buttons too
   Scintilla *sci = scintilla_new(scnotification, NULL);
   SSM(SCI_STYLESETFORE, STYLE_DEFAULT, 0xd8d8d8);
   SSM(SCI_STYLESETBACK, STYLE_DEFAULT, 0x181818);
@@ -71,13 +79,34 @@ int main(int argc, char **argv) {
   SSM(SCI_SETINDICATORCURRENT, 9, 0);
   SSM(SCI_INDICATORFILLRANGE, 1, 5);
 
+  SSM(SCI_SETMOUSEDWELLTIME, 500, 0);
   SSM(SCI_SETFOCUS, 1, 0);
+  scintilla_tick(sci); // style and wrap in the background
   scintilla_refresh(sci);
 
 struct tb_event ev;
-int c;
-while (tb_poll_event(&ev))
+int c, timeout, type;
+int resize_w = 0, resize_h = 0, resize_time = 0; // pending terminal resize, if resize_w > 0
+for (;;)
   {
+    timeout = scintilla_timeout(sci);
+    if (resize_w > 0) {
+      int wait = resize_time + RESIZE_DELAY - millis();
+      if (wait < 0) wait = 0;
+      if (timeout < 0 || timeout > wait) timeout = wait;
+    }
+    if ((type = timeout < 0 ? tb_poll_event(&ev) : tb_peek_event(&ev, timeout)) < 0) break;
+    if (type == 0) {
+      // Resize once the terminal has stopped resizing.
+      if (resize_w > 0 && millis() - resize_time >= RESIZE_DELAY) {
+        tb_clear(); // the window is the only thing drawn
+        scintilla_resize(sci, resize_w, resize_h);
+        resize_w = 0;
+      }
+      // Perform background work like idle styling when there are no events.
+      if (scintilla_tick(sci)) scintilla_refresh(sci);
+      continue;
+    }
     c = 0;
     switch (ev.type)
     {
@@ -107,9 +136,11 @@ while (tb_poll_event(&ev))
           c = SCK_RETURN;
           break;
         case TB_KEY_CTRL_A:
+          tb_clear(); // clear the cells the window leaves
           scintilla_resize(sci, 40, 20);
           break;
         case TB_KEY_CTRL_B:
+          tb_clear();
           scintilla_move(sci, 10, 19);
           break;
         case TB_KEY_CTRL_C:
@@ -143,15 +174,13 @@ while (tb_poll_event(&ev))
       break;
 
       case TB_EVENT_RESIZE:
+      resize_w = ev.w, resize_h = ev.h, resize_time = millis();
       break;
       case TB_EVENT_MOUSE:
       {
-        struct timeval time = {0, 0};
-        gettimeofday(&time, NULL);
         int event = 1;
-        int millis = time.tv_sec * 1000 + time.tv_usec / 1000;
          if (ev.mod == 2) {
-          event = 2;
+          event = ev.key == TB_KEY_MOUSE_RELEASE ? 4 : 2; // motion without a button is a move
         } else if (ev.key == TB_KEY_MOUSE_RELEASE) {
           event = 3;
         }
@@ -163,5 +192,6 @@ while (tb_poll_event(&ev))
   }
 
 done:
+  printf("\x1b[?1003l"), fflush(stdout);
   tb_shutdown();
 }